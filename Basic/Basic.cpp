@@ -5,10 +5,21 @@
  */
 
 #include <cctype>
+#include <charconv>
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cache.hpp"
 #include "exp.hpp"
+#include "input.hpp"
+#include "output.hpp"
 #include "parser.hpp"
+#include "profiler.hpp"
 #include "program.hpp"
 #include "Utils/error.hpp"
 #include "Utils/tokenScanner.hpp"
@@ -18,25 +29,101 @@
 /* Function prototypes */
 
 void processLine(std::string line, Program &program, EvalState &state);
+bool loadScript(const std::string &filename, Program &program, bool useCache);
+void loadProgramLines(std::string_view first, Program &program);
+void writeSamples();
+
+/* Name of the folded stack file written at exit, if --sample is given */
+
+static std::string sampleFile;
 
 /* Main program */
 
-int main() {
+int main(int argc, char **argv) {
     EvalState state;
     Program program;
+    std::string script;
+    std::string inputFile;
+    bool useCache = true;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--engine=tree") {
+            state.setEngine(TREE_WALKER);
+        } else if (arg == "--engine=threaded") {
+            state.setEngine(THREADED);
+        } else if (arg == "--engine=jit") {
+            state.setEngine(JIT);
+        } else if (arg == "--flush=line") {
+            Output::setPolicy(FLUSH_LINES);
+        } else if (arg == "--flush=block") {
+            Output::setPolicy(FLUSH_FULL);
+        } else if (arg == "--no-cache") {
+            useCache = false;
+        } else if (arg.compare(0, 9, "--sample=") == 0 && arg.length() > 9) {
+            sampleFile = arg.substr(9);
+        } else if (arg == "--input" && i + 1 < argc) {
+            inputFile = argv[++i];
+        } else if (arg[0] != '-' && script.empty()) {
+            script = arg;
+        } else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--engine=tree|threaded|jit] [--flush=line|block] [--sample=file]"
+                      << " [file.bas [--input file] [--no-cache]]"
+                      << std::endl;
+            return 1;
+        }
+    }
+    if (!inputFile.empty() && !Input::open(inputFile)) {
+        std::cerr << argv[0] << ": cannot open " << inputFile << std::endl;
+        return 1;
+    }
+    if (!sampleFile.empty()) {
+        if (!Sampler::start(1000)) {
+            std::cerr << argv[0] << ": cannot start the sampler" << std::endl;
+            return 1;
+        }
+        atexit(writeSamples);
+    }
+    if (!script.empty()) {
+        try {
+            if (!loadScript(script, program, useCache)) {
+                std::cerr << argv[0] << ": cannot open " << script << std::endl;
+                return 1;
+            }
+            RunStatement().execute(state, program);
+        } catch (ErrorException &ex) {
+            Output::writeLine(ex.getMessage());
+            Output::flush();
+            return 1;
+        } catch (...) {
+            Output::flush();
+            throw;
+        }
+        Output::flush();
+        return 0;
+    }
     //cout << "Stub implementation of BASIC" << endl;
     while (true) {
         try {
-            std::string input;
-            getline(std::cin, input);
+            std::string_view input;
+            if (!Input::readLine(input))
+                break;
             if (input.empty())
                 continue;
-            processLine(input, program, state);
+            if (isdigit((unsigned char) input[0])) {
+                loadProgramLines(input, program);
+                continue;
+            }
+            processLine(std::string(input), program, state);
         } catch (ErrorException &ex) {
-            std::cout << ex.getMessage() << std::endl;
+            Output::writeLine(ex.getMessage());
             break;
+        } catch (...) {
+            Output::flush();
+            throw;
         }
     }
+    Output::flush();
     return 0;
 }
 
@@ -53,10 +140,11 @@ int main() {
  */
 
 void processLine(std::string line, Program &program, EvalState &state) {
+    Arena arena;
     TokenScanner scanner;
     scanner.ignoreWhitespace();
     scanner.scanNumbers();
-    scanner.setInput(line);
+    scanner.setInputView(line);
     std::string tmp = scanner.nextToken();
     if (scanner.getTokenType(tmp) == NUMBER) {
         int linenumber = std::stoi(tmp); ///Have some risk!!
@@ -66,123 +154,101 @@ void processLine(std::string line, Program &program, EvalState &state) {
         }
         program.addSourceLine(linenumber, line);
         return;
-    } else {
-        if (tmp == "LET") {
-            if (!scanner.hasMoreTokens()) {
-                std::cout << "SYNTAX ERROR" << std::endl;
-                return;
-            } else {
-                std::string variable = scanner.nextToken();
-                if (scanner.nextToken()[0] == '=') {
-                    if (scanner.hasMoreTokens()) {
-                        std::string ex;
-                        while (scanner.hasMoreTokens()) {
-                            ex += scanner.nextToken() + ' ';
-                        }
-                        TokenScanner expp;
-                        expp.ignoreWhitespace();
-                        expp.scanNumbers();
-                        expp.setInput(ex);
-                        Expression *exp = parseExp(expp);
-                        Statement *sta = new LetStatement(variable, exp);
-                        sta->execute(state, program);
-                        delete sta;
-                        return;
-                    } else {
-                        std::cout << "SYNTAX ERROR" << std::endl;
-                        return;
-                    }
-                } else {
-                    std::cout << "SYNTAX ERROR" << std::endl;
-                    return;
-                }
-            }
-            return;
-        }
-        if (tmp == "PRINT")
-        {
-            if (!scanner.hasMoreTokens()) {
-                std::cout << "SYNTAX ERROR" << std::endl;
-                return;
-            } else {
-                std::string ex;
-                while (scanner.hasMoreTokens()) {
-                    ex += scanner.nextToken() + ' ';
-                }
-                TokenScanner expp;
-                expp.ignoreWhitespace();
-                expp.scanNumbers();
-                expp.setInput(ex);
-                Expression *exp = parseExp(expp);
-                Statement *sta = new PrintStatement(exp);
-                sta->execute(state, program);
-                delete sta;
-                return;
-            }
-            return;
-        }
-        if (tmp == "INPUT")
-        {
-            if (!scanner.hasMoreTokens()) {
-                std::cout << "SYNTAX ERROR" << std::endl;
-                return;
-            } else {
-                std::string variable = scanner.nextToken();
-                if (scanner.hasMoreTokens()) {
-                    std::cout << "SYNTAX ERROR" << std::endl;
-                    return;
-                }
-                Statement *sta = new InputStatement(variable);
-                sta->execute(state, program);
-                delete sta;
-                return;
+    }
+    Statement *sta;
+    {
+        SamplePhaseScope phase(PHASE_PARSE);
+        sta = parseStatement(tmp, scanner, arena, IMMEDIATE_MODE);
+    }
+    if (sta != nullptr) {
+        SamplePhaseScope phase(PHASE_EXECUTE);
+        sta->execute(state, program);
+    }
+}
+
+
+/*
+ * Function: loadScript
+ * Usage: if (loadScript(filename, program, useCache)) ...
+ * -------------------------------------------------------
+ * Adds every line of the named BASIC source file to the program and
+ * returns true, or returns false if the file cannot be read.  The file
+ * is mapped into memory and handed to Program::loadSource as a whole,
+ * so no line goes through the command loop or is ever parsed as an
+ * immediate command.  With useCache set, the compiled program is
+ * restored from the cache file next to the source when that file
+ * matches the source, and otherwise written there after a clean load,
+ * so later runs of the same file skip parsing altogether.
+ */
+
+bool loadScript(const std::string &filename, Program &program, bool useCache) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = info.st_size;
+    void *mapped = nullptr;
+    if (size > 0) {
+        mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    std::string_view source((const char *) mapped, size);
+    std::string cache = getCacheName(filename);
+    try {
+        if (!useCache || !loadProgramCache(cache, source, program)) {
+            if (program.loadSource(source) && useCache) {
+                saveProgramCache(cache, source, program);
             }
-            return;
-        }
-        if (tmp == "END") {
-            Statement *sta = new EndStatement();
-            sta->execute(state, program);
-            delete sta;
-            return;
-        }
-        if (tmp == "REM") {
-            Statement *sta = new REMStatement();
-            sta->execute(state, program);
-            delete sta;
-            return;
-        }
-        if (tmp == "RUN") {
-            Statement *sta = new RunStatement();
-            sta->execute(state, program);
-            delete sta;
-            return;
-        }
-        if (tmp == "LIST") {
-            Statement *sta = new ListStatement();
-            sta->execute(state, program);
-            delete sta;
-            return;
-        }
-        if (tmp == "CLEAR") {
-            Statement *sta = new ClearStatement();
-            sta->execute(state, program);
-            delete sta;
-            return;
-        }
-        if (tmp == "QUIT") {
-            Statement *sta = new QuitStatement();
-            sta->execute(state, program);
-            delete sta;
-            return;
-        }
-        if (tmp == "HELP") {
-            Statement *sta = new HelpStatement();
-            sta->execute(state, program);
-            delete sta;
-            return;
         }
-        std::cout << "SYNTAX ERROR" << std::endl;
-        return;
+    } catch (...) {
+        if (size > 0) munmap(mapped, size);
+        throw;
+    }
+    if (size > 0) munmap(mapped, size);
+    return true;
+}
+
+/*
+ * Function: loadProgramLines
+ * Usage: loadProgramLines(first, program);
+ * ----------------------------------------
+ * Adds the numbered line just read, together with every numbered line
+ * directly behind it that is already waiting in the input buffer, as
+ * one block through Program::loadSource.  A pasted or piped program is
+ * therefore parsed in bulk, while a line typed at the terminal is
+ * added on its own as before.  The lines are contiguous in the input
+ * buffer, which stays in place as long as only buffered lines are read.
+ */
+
+void loadProgramLines(std::string_view first, Program &program) {
+    std::string_view last = first;
+    std::string_view next;
+    while (Input::peekLine(next) && !next.empty() && isdigit((unsigned char) next[0])) {
+        Input::readLine(last);
     }
+    program.loadSource(std::string_view(first.data(), last.data() + last.length() - first.data()));
 }
 
+/*
+ * Function: writeSamples
+ * Usage: atexit(writeSamples);
+ * ----------------------------
+ * Stops the sampler started by --sample and writes what it collected
+ * over the whole session to the named file as folded stacks.  It runs
+ * at exit so that a session ended by QUIT is covered as well.
+ */
+
+void writeSamples() {
+    Sampler::stop();
+    if (!Sampler::writeFolded(sampleFile)) {
+        std::cerr << "cannot write " << sampleFile << std::endl;
+    }
+}
@@ -0,0 +1,306 @@
+/*
+ * File: lexer.cpp
+ * ---------------
+ * Implementation for the Lexer class.
+ */
+
+#include <cctype>
+#include <cstdio>
+#include "error.hpp"
+#include "lexer.hpp"
+
+Lexer::Lexer() {
+    ignoreWhitespaceFlag = false;
+    ignoreCommentsFlag = false;
+    scanNumbersFlag = false;
+    scanStringsFlag = false;
+    for (short &root : operatorRoots) root = -1;
+    setInput(std::string_view());
+}
+
+void Lexer::setInput(std::string_view text) {
+    this->text = text.data();
+    length = text.size();
+    pos = 0;
+    exhausted = false;
+}
+
+/*
+ * Implementation notes: next
+ * --------------------------
+ * This is the token loop of the original stream-based scanner, with
+ * reads and pushbacks turned into moves of the position.  A token is
+ * the span of characters the loop accepted, which for a number can
+ * differ from the characters consumed: like the stream version, a
+ * dangling exponent such as the "e" in "12eX" stays in the token but
+ * is scanned again.
+ */
+
+Token Lexer::next() {
+    while (true) {
+        if (ignoreWhitespaceFlag) skipSpaces();
+        int ch = get();
+        if (ch == '/' && ignoreCommentsFlag) {
+            ch = get();
+            if (ch == '/') {
+                while (true) {
+                    ch = get();
+                    if (ch == '\n' || ch == '\r' || ch == EOF) break;
+                }
+                continue;
+            } else if (ch == '*') {
+                int prev = EOF;
+                while (true) {
+                    ch = get();
+                    if (ch == EOF || (prev == '*' && ch == '/')) break;
+                    prev = ch;
+                }
+                continue;
+            }
+            if (ch != EOF) unget();
+            ch = '/';
+        }
+        if (ch == EOF) return {std::string_view(), TokenType(EOF)};
+        if ((ch == '"' || ch == '\'') && scanStringsFlag) {
+            unget();
+            return scanString();
+        }
+        if (isdigit(ch) && scanNumbersFlag) {
+            unget();
+            return scanNumber();
+        }
+        if (isWordCharacter(ch)) {
+            unget();
+            return scanWord();
+        }
+        int start = pos - 1;
+        int count = 1;
+        int node = operatorRoots[(unsigned char) ch];
+        if (node >= 0) {
+            int matched = 1;
+            while (true) {
+                ch = get();
+                if (ch == EOF) break;
+                int child = findChild(node, ch);
+                if (child < 0) {
+                    unget();
+                    break;
+                }
+                node = child;
+                count++;
+                if (operatorNodes[node].terminal) matched = count;
+            }
+            for (; count > matched; count--) {
+                unget();
+            }
+        }
+        return makeToken(start, count);
+    }
+}
+
+int Lexer::getPosition() const {
+    return exhausted ? -1 : pos;
+}
+
+std::string_view Lexer::getInput() const {
+    return std::string_view(text, length);
+}
+
+void Lexer::ignoreWhitespace() {
+    ignoreWhitespaceFlag = true;
+}
+
+void Lexer::ignoreComments() {
+    ignoreCommentsFlag = true;
+}
+
+void Lexer::scanNumbers() {
+    scanNumbersFlag = true;
+}
+
+void Lexer::scanStrings() {
+    scanStringsFlag = true;
+}
+
+void Lexer::addWordCharacters(const std::string &str) {
+    wordChars += str;
+}
+
+void Lexer::addOperator(const std::string &op) {
+    if (op.empty()) return;
+    unsigned char first = op[0];
+    if (operatorRoots[first] < 0) {
+        operatorRoots[first] = operatorNodes.size();
+        operatorNodes.push_back({first, false, -1, -1});
+    }
+    int node = operatorRoots[first];
+    for (size_t i = 1; i < op.length(); i++) {
+        unsigned char ch = op[i];
+        int child = findChild(node, ch);
+        if (child < 0) {
+            child = operatorNodes.size();
+            operatorNodes.push_back({ch, false, -1, operatorNodes[node].child});
+            operatorNodes[node].child = child;
+        }
+        node = child;
+    }
+    operatorNodes[node].terminal = true;
+}
+
+bool Lexer::isWordCharacter(int ch) const {
+    return isalnum(ch) || (ch != EOF && wordChars.find(char(ch)) != std::string::npos);
+}
+
+TokenType Lexer::classify(std::string_view text) const {
+    if (text.empty()) return TokenType(EOF);
+    unsigned char ch = text[0];
+    if (isspace(ch)) return SEPARATOR;
+    if (ch == '"' || (ch == '\'' && text.length() > 1)) return STRING;
+    if (isdigit(ch)) return NUMBER;
+    if (isWordCharacter(ch)) return WORD;
+    return OPERATOR;
+}
+
+/* Private methods */
+
+Token Lexer::makeToken(int start, int count) const {
+    std::string_view span(text + start, count);
+    return {span, classify(span)};
+}
+
+void Lexer::skipSpaces() {
+    while (true) {
+        int ch = get();
+        if (ch == EOF) return;
+        if (!isspace(ch)) {
+            unget();
+            return;
+        }
+    }
+}
+
+Token Lexer::scanWord() {
+    int start = pos;
+    int count = 0;
+    while (true) {
+        int ch = get();
+        if (ch == EOF) break;
+        if (!isWordCharacter(ch)) {
+            unget();
+            break;
+        }
+        count++;
+    }
+    return makeToken(start, count);
+}
+
+/*
+ * Implementation notes: scanNumber
+ * --------------------------------
+ * The same finite-state machine as the stream-based scanner.  Every
+ * character that leaves the machine in a non-final state extends the
+ * token; the pushbacks on a malformed exponent only move the position.
+ */
+
+Token Lexer::scanNumber() {
+    enum {
+        INITIAL_STATE, BEFORE_DECIMAL_POINT, AFTER_DECIMAL_POINT, STARTING_EXPONENT,
+        FOUND_EXPONENT_SIGN, SCANNING_EXPONENT, FINAL_STATE
+    } state = INITIAL_STATE;
+    int start = pos;
+    int count = 0;
+    while (state != FINAL_STATE) {
+        int ch = get();
+        switch (state) {
+            case INITIAL_STATE:
+                if (!isdigit(ch)) {
+                    error("Internal error: illegal call to scanNumber");
+                }
+                state = BEFORE_DECIMAL_POINT;
+                break;
+            case BEFORE_DECIMAL_POINT:
+                if (ch == '.') {
+                    state = AFTER_DECIMAL_POINT;
+                } else if (ch == 'E' || ch == 'e') {
+                    state = STARTING_EXPONENT;
+                } else if (!isdigit(ch)) {
+                    if (ch != EOF) unget();
+                    state = FINAL_STATE;
+                }
+                break;
+            case AFTER_DECIMAL_POINT:
+                if (ch == 'E' || ch == 'e') {
+                    state = STARTING_EXPONENT;
+                } else if (!isdigit(ch)) {
+                    if (ch != EOF) unget();
+                    state = FINAL_STATE;
+                }
+                break;
+            case STARTING_EXPONENT:
+                if (ch == '+' || ch == '-') {
+                    state = FOUND_EXPONENT_SIGN;
+                } else if (isdigit(ch)) {
+                    state = SCANNING_EXPONENT;
+                } else {
+                    if (ch != EOF) unget();
+                    unget();
+                    state = FINAL_STATE;
+                }
+                break;
+            case FOUND_EXPONENT_SIGN:
+                if (isdigit(ch)) {
+                    state = SCANNING_EXPONENT;
+                } else {
+                    if (ch != EOF) unget();
+                    unget();
+                    unget();
+                    state = FINAL_STATE;
+                }
+                break;
+            case SCANNING_EXPONENT:
+                if (!isdigit(ch)) {
+                    if (ch != EOF) unget();
+                    state = FINAL_STATE;
+                }
+                break;
+            default:
+                state = FINAL_STATE;
+                break;
+        }
+        if (state != FINAL_STATE) {
+            count++;
+        }
+    }
+    return makeToken(start, count);
+}
+
+Token Lexer::scanString() {
+    int start = pos;
+    int delim = get();
+    bool escape = false;
+    while (true) {
+        int ch = get();
+        if (ch == EOF) error("TokenScanner found unterminated string");
+        if (ch == delim && !escape) break;
+        escape = (ch == '\\') && !escape;
+    }
+    return makeToken(start, pos - start);
+}
+
+/*
+ * Implementation notes: findChild
+ * -------------------------------
+ * Operators are kept in a trie whose roots are found through a table
+ * indexed by the first character, so a character that starts no
+ * operator costs one lookup.  Reading an operator walks the trie while
+ * the next character extends some operator and then backs up to the
+ * longest complete one, which gives the same tokens as growing the
+ * string while it is a prefix and shrinking it until it is an operator.
+ */
+
+int Lexer::findChild(int node, int ch) const {
+    for (int child = operatorNodes[node].child; child >= 0; child = operatorNodes[child].sibling) {
+        if (operatorNodes[child].ch == ch) return child;
+    }
+    return -1;
+}
@@ -0,0 +1,207 @@
+/*
+ * File: lexer.h
+ * -------------
+ * This file exports the <code>Lexer</code> class, the scanning core
+ * behind <code>TokenScanner</code>.  A lexer reads directly from a
+ * caller-owned <code>std::string_view</code> and returns tokens as
+ * spans of that text, so scanning a line allocates nothing.
+ */
+
+#ifndef _lexer_h
+#define _lexer_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Type: TokenType
+ * ---------------
+ * This enumerated type defines the values of the
+ * <code>getTokenType</code> method.
+ */
+
+enum TokenType {
+    SEPARATOR, WORD, NUMBER, STRING, OPERATOR
+};
+
+/*
+ * Type: Token
+ * -----------
+ * A token returned by a lexer: a span of the input text together with
+ * its type, which is computed once when the token is scanned.  At the
+ * end of the input the text is empty and the type is TokenType(EOF).
+ */
+
+struct Token {
+    std::string_view text;
+    TokenType type;
+};
+
+/*
+ * Class: Lexer
+ * ------------
+ * Divides a span of text into tokens following exactly the rules of
+ * <code>TokenScanner</code>, including how the scanner backs up after
+ * reading past the end of the input.  The text must stay alive and
+ * unchanged while the lexer reads from it.
+ */
+
+class Lexer {
+
+public:
+
+/*
+ * Constructor: Lexer
+ * Usage: Lexer lexer;
+ * -------------------
+ * Initializes a lexer with an empty input and every option off.
+ */
+
+    Lexer();
+
+/*
+ * Method: setInput
+ * Usage: lexer.setInput(text);
+ * ----------------------------
+ * Starts scanning the specified text from its first character.
+ */
+
+    void setInput(std::string_view text);
+
+/*
+ * Method: next
+ * Usage: Token token = lexer.next();
+ * ----------------------------------
+ * Returns the next token from the input, or an empty token at the end.
+ */
+
+    Token next();
+
+/*
+ * Methods: get, unget
+ * Usage: int ch = lexer.get();
+ *        lexer.unget();
+ * --------------------------
+ * Reads a single character, or EOF at the end of the input, and steps
+ * back over the last character read.  As with an input stream, once
+ * get has returned EOF the lexer stays at the end.
+ */
+
+    int get();
+
+    void unget();
+
+/*
+ * Method: getPosition
+ * Usage: int pos = lexer.getPosition();
+ * -------------------------------------
+ * Returns the index of the next character, or -1 once the lexer has
+ * read past the end of the input.
+ */
+
+    int getPosition() const;
+
+/*
+ * Method: getInput
+ * Usage: std::string_view text = lexer.getInput();
+ * ------------------------------------------------
+ * Returns the whole text being scanned.
+ */
+
+    std::string_view getInput() const;
+
+/*
+ * Methods: ignoreWhitespace, ignoreComments, scanNumbers, scanStrings,
+ *          addWordCharacters, addOperator
+ * --------------------------------------------------------------------
+ * These methods set the scanning options described for the
+ * corresponding methods of <code>TokenScanner</code>.
+ */
+
+    void ignoreWhitespace();
+
+    void ignoreComments();
+
+    void scanNumbers();
+
+    void scanStrings();
+
+    void addWordCharacters(const std::string &str);
+
+    void addOperator(const std::string &op);
+
+/*
+ * Method: isWordCharacter
+ * Usage: if (lexer.isWordCharacter(ch)) ...
+ * -----------------------------------------
+ * Returns true if the character is valid in a word.
+ */
+
+    bool isWordCharacter(int ch) const;
+
+/*
+ * Method: classify
+ * Usage: TokenType type = lexer.classify(text);
+ * ---------------------------------------------
+ * Returns the type of a token from its first character, using the same
+ * rules as <code>TokenScanner::getTokenType</code>.
+ */
+
+    TokenType classify(std::string_view text) const;
+
+private:
+
+/*
+ * Private type: OperatorNode
+ * --------------------------
+ * A node of the operator trie.  The children of a node are chained
+ * through sibling; terminal marks the end of a defined operator.
+ */
+
+    struct OperatorNode {
+        int ch;
+        bool terminal;
+        short child;
+        short sibling;
+    };
+
+    const char *text;                /* The input being scanned         */
+    int length;                      /* Length of the input             */
+    int pos;                         /* Index of the next character     */
+    bool exhausted;                  /* A read went past the end        */
+    bool ignoreWhitespaceFlag;       /* Scanner ignores whitespace      */
+    bool ignoreCommentsFlag;         /* Scanner ignores comments        */
+    bool scanNumbersFlag;            /* Scanner parses numbers          */
+    bool scanStringsFlag;            /* Scanner parses strings          */
+    std::string wordChars;           /* Additional word characters      */
+    short operatorRoots[256];        /* Trie node for each first char   */
+    std::vector<OperatorNode> operatorNodes;  /* Trie of operators      */
+
+    Token makeToken(int start, int count) const;
+
+    void skipSpaces();
+
+    Token scanWord();
+
+    Token scanNumber();
+
+    Token scanString();
+
+    int findChild(int node, int ch) const;
+
+};
+
+inline int Lexer::get() {
+    if (pos >= length) {
+        exhausted = true;
+        return EOF;
+    }
+    return (unsigned char) text[pos++];
+}
+
+inline void Lexer::unget() {
+    if (!exhausted && pos > 0) pos--;
+}
+
+#endif
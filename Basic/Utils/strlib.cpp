@@ -5,6 +5,7 @@
  */
 
 #include <cctype>
+#include <charconv>
 #include <iomanip>
 #include <sstream>
 #include <iostream>
@@ -16,7 +17,11 @@
 /*
  * Implementation notes: numeric conversion
  * ----------------------------------------
- * These functions use the <sstream> library to perform the conversion.
+ * These functions use the <sstream> library to perform the conversion,
+ * except stringToInteger, which sits on the expression parser's path for
+ * every numeric literal and uses std::from_chars instead.  It accepts
+ * exactly what extracting an int from a stream followed by white space
+ * accepts: surrounding white space and an optional sign.
  */
 
 std::string integerToString(int n) {
@@ -26,12 +31,15 @@ std::string integerToString(int n) {
 }
 
 int stringToInteger(std::string str) {
-
-    std::istringstream stream(str);
-    int value;
-    stream >> value;
-    if (!stream.eof()) stream >> std::ws;
-    if (stream.fail() || !stream.eof()) {
+    const char *cp = str.data();
+    const char *end = cp + str.length();
+    while (cp < end && isspace((unsigned char) *cp)) cp++;
+    if (cp + 1 < end && *cp == '+' && *(cp + 1) != '-') cp++;
+    int value = 0;
+    std::from_chars_result result = std::from_chars(cp, end, value);
+    cp = result.ptr;
+    while (cp < end && isspace((unsigned char) *cp)) cp++;
+    if (result.ec != std::errc() || cp != end) {
         error("stringToInteger: Illegal integer format (" + str + ")");
     }
     return value;
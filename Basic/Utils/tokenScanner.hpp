@@ -16,18 +16,9 @@
 
 #include <iostream>
 #include <string>
-#include <sstream>
-
-/*
- * Type: TokenType
- * ---------------
- * This enumerated type defines the values of the
- * <code>getTokenType</code> method.
- */
-
-enum TokenType {
-    SEPARATOR, WORD, NUMBER, STRING, OPERATOR
-};
+#include <string_view>
+#include <vector>
+#include "lexer.hpp"
 
 /*
  * Class: TokenScanner
@@ -48,6 +39,9 @@ enum TokenType {
  * The <code>TokenScanner</code> class exports several additional methods
  * that give clients more control over its behavior.  Those methods are
  * described individually in the documentation.
+ *
+ * The scanning itself is done by a <code>Lexer</code>; this class adds
+ * ownership of the input and the string-based interface on top.
  */
 
 class TokenScanner {
@@ -85,13 +79,25 @@ public:
  *        scanner.setInput(infile);
  * --------------------------------
  * Sets the token stream for this scanner to the specified string or
- * input stream.  Any previous token stream is discarded.
+ * input stream.  Any previous token stream is discarded.  The scanner
+ * keeps its own copy of the string; an input stream is read to its end
+ * when setInput is called.
  */
 
     void setInput(std::string str);
 
     void setInput(std::istream &infile);
 
+/*
+ * Method: setInputView
+ * Usage: scanner.setInputView(text);
+ * ----------------------------------
+ * Sets the token stream to the specified text without copying it.  The
+ * caller must keep the text alive and unchanged while scanning.
+ */
+
+    void setInputView(std::string_view text);
+
 /*
  * Method: hasMoreTokens
  * Usage: if (scanner.hasMoreTokens()) ...
@@ -112,6 +118,18 @@ public:
 
     std::string nextToken();
 
+/*
+ * Method: next
+ * Usage: Token token = scanner.next();
+ * ------------------------------------
+ * Returns the next token as a span with its type, without copying its
+ * text.  The span stays valid until the input changes, except for a
+ * token that was saved with text the scanner had not just returned,
+ * which is valid only until the next call.
+ */
+
+    Token next();
+
 /*
  * Method: saveToken
  * Usage: scanner.saveToken(token);
@@ -119,10 +137,25 @@ public:
  * Pushes the specified token back into this scanner's input stream.
  * On the next call to <code>nextToken</code>, the scanner will return
  * the saved token without reading any additional characters from the
- * token stream.
+ * token stream.  Saving the empty string, which only marks the end of
+ * the tokens, has no effect.
+ */
+
+    void saveToken(std::string_view token);
+
+/*
+ * Method: stopAt
+ * Usage: scanner.stopAt(isComparison);
+ *        scanner.stopAt(nullptr);
+ * ------------------------------------
+ * Makes the scanner report the end of its tokens when the next token
+ * satisfies the predicate.  That token stays in the stream and is
+ * returned once the limit is lifted by calling stopAt(nullptr).  This
+ * lets a parser read part of a statement in place, for example the
+ * left side of a comparison.
  */
 
-    void saveToken(std::string token);
+    void stopAt(bool (*predicate)(std::string_view token));
 
 /*
  * Method: getPosition
@@ -136,6 +169,19 @@ public:
 
     int getPosition() const;
 
+/*
+ * Method: readRest
+ * Usage: std::string_view rest = scanner.readRest();
+ * --------------------------------------------------
+ * Returns the input from the start of the next token to the end,
+ * exactly as it was given, and leaves no tokens behind.  It is meant
+ * for operands such as file names that are not made of tokens.  The
+ * span stays valid until the input changes; a token saved with text
+ * the scanner had not just returned is returned alone.
+ */
+
+    std::string_view readRest();
+
 /*
  * Method: ignoreWhitespace
  * Usage: scanner.ignoreWhitespace();
@@ -307,55 +353,26 @@ public:
 private:
 
 /*
- * Private type: StringCell
- * ------------------------
- * This type is used to construct linked lists of cells, which are used
- * to represent both the stack of saved tokens and the set of defined
- * operators.  These types cannot use the Stack and Lexicon classes
- * directly because tokenscanner.h is an extremely low-level interface,
- * and doing so would create circular dependencies in the .h files.
+ * Implementation notes: lookahead
+ * -------------------------------
+ * The tokens most recently read from the lexer are kept in a small
+ * ring, indexed by the running counts of tokens lexed and consumed.
+ * Saving the token that was just returned, which is what hasMoreTokens
+ * and the parser do, only steps the consumed count back; any other
+ * saved text is copied onto the pushed stack, which is the only path
+ * that allocates.
  */
 
-    struct StringCell {
-        std::string str;
-        StringCell *link;
-    };
-
-    enum NumberScannerState {
-        INITIAL_STATE,
-        BEFORE_DECIMAL_POINT,
-        AFTER_DECIMAL_POINT,
-        STARTING_EXPONENT,
-        FOUND_EXPONENT_SIGN,
-        SCANNING_EXPONENT,
-        FINAL_STATE
-    };
-
-    std::string buffer;              /* The original argument string */
-    std::istream *isp = nullptr;     /* The input stream for tokens  */
-    bool ignoreWhitespaceFlag;       /* Scanner ignores whitespace   */
-    bool ignoreCommentsFlag;         /* Scanner ignores comments     */
-    bool scanNumbersFlag;            /* Scanner parses numbers       */
-    bool scanStringsFlag;            /* Scanner parses strings       */
-    std::string wordChars;           /* Additional word characters   */
-    StringCell *savedTokens = nullptr;         /* Stack of saved tokens        */
-    StringCell *operators = nullptr;           /* List of multichar operators  */
-
-/* Private method prototypes */
-
-    void initScanner();
-
-    void skipSpaces();
-
-    std::string scanWord();
-
-    std::string scanNumber();
-
-    std::string scanString();
-
-    bool isOperator(std::string op);
+    static const int LOOKAHEAD = 4;
 
-    bool isOperatorPrefix(std::string op);
+    std::string buffer;              /* The owned copy of the input     */
+    Lexer lexer;                     /* The scanner over the input      */
+    Token ring[LOOKAHEAD];           /* Recently lexed tokens           */
+    unsigned lexed = 0;              /* Tokens read from the lexer      */
+    unsigned consumed = 0;           /* Tokens returned from the ring   */
+    std::vector<std::string> pushed; /* Saved tokens not from the ring  */
+    std::string current;             /* Text of the last pushed token   */
+    bool (*stopPredicate)(std::string_view) = nullptr;  /* Token ending the stream */
 
 };
 
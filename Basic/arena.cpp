@@ -0,0 +1,77 @@
+/*
+ * File: arena.cpp
+ * ---------------
+ * This file implements the Arena class.
+ */
+
+#include <cstdlib>
+#include "arena.hpp"
+
+
+Arena::Arena() : chunks(nullptr), cursor(nullptr), limit(nullptr) {}
+
+Arena::~Arena() {
+    release();
+}
+
+void Arena::release() {
+    while (chunks != nullptr) {
+        Chunk *next = chunks->next;
+        std::free(chunks);
+        chunks = next;
+    }
+    cursor = nullptr;
+    limit = nullptr;
+}
+
+/*
+ * Implementation notes: adopt
+ * ---------------------------
+ * The adopted chunks are spliced in behind the current chunk, so the
+ * free space left in it is still used by later allocations.
+ */
+
+void Arena::adopt(Arena &other) {
+    if (other.chunks == nullptr) return;
+    Chunk *last = other.chunks;
+    while (last->next != nullptr) {
+        last = last->next;
+    }
+    if (chunks == nullptr) {
+        chunks = other.chunks;
+    } else {
+        last->next = chunks->next;
+        chunks->next = other.chunks;
+    }
+    other.chunks = nullptr;
+    other.cursor = nullptr;
+    other.limit = nullptr;
+}
+
+/*
+ * Implementation notes: grow
+ * --------------------------
+ * Starts a new chunk when the current one cannot hold the request.
+ * Requests larger than a chunk get a block of their own, which is
+ * linked behind the current chunk so that the space left in the
+ * current chunk is still used by later small allocations.
+ */
+
+void *Arena::grow(std::size_t size, std::size_t align) {
+    std::size_t header = (sizeof(Chunk) + align - 1) & ~(align - 1);
+    if (header + size > CHUNK_SIZE && chunks != nullptr) {
+        Chunk *chunk = static_cast<Chunk *>(std::malloc(header + size));
+        if (chunk == nullptr) throw std::bad_alloc();
+        chunk->next = chunks->next;
+        chunks->next = chunk;
+        return reinterpret_cast<char *>(chunk) + header;
+    }
+    std::size_t total = header + size > CHUNK_SIZE ? header + size : CHUNK_SIZE;
+    Chunk *chunk = static_cast<Chunk *>(std::malloc(total));
+    if (chunk == nullptr) throw std::bad_alloc();
+    chunk->next = chunks;
+    chunks = chunk;
+    cursor = reinterpret_cast<char *>(chunk) + header + size;
+    limit = reinterpret_cast<char *>(chunk) + total;
+    return reinterpret_cast<char *>(chunk) + header;
+}
@@ -0,0 +1,139 @@
+/*
+ * File: arena.h
+ * -------------
+ * This interface exports the Arena class, a bump allocator that owns
+ * the parsed form of BASIC statements and expressions.
+ */
+
+#ifndef _arena_h
+#define _arena_h
+
+#include <cstddef>
+#include <new>
+
+/*
+ * Class: Arena
+ * ------------
+ * An arena hands out memory from large chunks by advancing a cursor
+ * and releases everything it allocated in one step.  Objects placed in
+ * an arena are never deleted individually and their destructors are
+ * not run, so they must not own any other heap storage.  Statements and
+ * PostfixExp expressions are built this way; everything they refer to
+ * lives in the same arena.  Because of the cursor allocation, the nodes
+ * of one line sit next to each other in memory.
+ */
+
+class Arena {
+
+public:
+
+/*
+ * Constructor: Arena
+ * Usage: Arena arena;
+ * -------------------
+ * Creates an empty arena.  No memory is reserved until the first
+ * allocation.
+ */
+
+    Arena();
+
+/*
+ * Destructor: ~Arena
+ * Usage: usually implicit
+ * -----------------------
+ * Frees every chunk owned by the arena.
+ */
+
+    ~Arena();
+
+    Arena(const Arena &) = delete;
+
+    Arena &operator=(const Arena &) = delete;
+
+/*
+ * Method: allocate
+ * Usage: void *p = arena.allocate(size, align);
+ * ---------------------------------------------
+ * Returns size bytes of storage aligned to align, which must be a
+ * power of two.  The storage remains valid until release is called
+ * or the arena is destroyed.
+ */
+
+    void *allocate(std::size_t size, std::size_t align = alignof(std::max_align_t));
+
+/*
+ * Method: release
+ * Usage: arena.release();
+ * -----------------------
+ * Frees all storage handed out by the arena at once.
+ */
+
+    void release();
+
+/*
+ * Method: adopt
+ * Usage: arena.adopt(other);
+ * --------------------------
+ * Takes over every chunk of the other arena, leaving it empty.  Objects
+ * allocated in the other arena stay where they are and are released
+ * together with this arena.
+ */
+
+    void adopt(Arena &other);
+
+private:
+
+/*
+ * Private type: Chunk
+ * -------------------
+ * Header at the start of each block obtained from the system.  The
+ * chunks form a singly linked list so that release can free them.
+ */
+
+    struct Chunk {
+        Chunk *next;
+    };
+
+    static const std::size_t CHUNK_SIZE = 64 * 1024;
+
+    Chunk *chunks;               /* Most recent chunk first          */
+    char *cursor;                /* Next free byte in current chunk  */
+    char *limit;                 /* End of the current chunk         */
+
+    void *grow(std::size_t size, std::size_t align);
+
+};
+
+/*
+ * Implementation notes: allocate
+ * ------------------------------
+ * The common case only rounds the cursor up and compares it against
+ * the end of the chunk, so it is defined inline.
+ */
+
+inline void *Arena::allocate(std::size_t size, std::size_t align) {
+    std::size_t pad = -reinterpret_cast<std::size_t>(cursor) & (align - 1);
+    if (cursor != nullptr && size + pad <= std::size_t(limit - cursor)) {
+        void *p = cursor + pad;
+        cursor += pad + size;
+        return p;
+    }
+    return grow(size, align);
+}
+
+/*
+ * Operator: new
+ * Usage: Statement *stmt = new (arena) PrintStatement(exp);
+ * ---------------------------------------------------------
+ * Places a new object in the specified arena.  The matching delete
+ * is only called by the compiler if the constructor throws; it leaves
+ * the storage to the arena.
+ */
+
+inline void *operator new(std::size_t size, Arena &arena) {
+    return arena.allocate(size);
+}
+
+inline void operator delete(void *, Arena &) {}
+
+#endif
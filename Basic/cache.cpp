@@ -0,0 +1,494 @@
+/*
+ * File: cache.cpp
+ * ---------------
+ * This file implements the cache.h interface.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cache.hpp"
+
+/*
+ * Implementation notes: file format
+ * ---------------------------------
+ * A cache file is the following sections, each an array of the fixed
+ * size records below in native byte order, one after the other:
+ *
+ *    CacheHeader   identification and the size of every section
+ *    CachedLine    one per program line, in ascending line order
+ *    CachedExp     one per expression, indexing the code section
+ *    CachedText    one per variable name, indexing the text section
+ *    CachedVar     one per variable with a value, in snapshots only
+ *    PostfixInstr  the postfix code of all expressions
+ *    char          the stored source lines and the variable names
+ *
+ * Variable slots are assigned per process, so the code refers to
+ * variables by their index in the symbol section, and loading maps
+ * every symbol back to a slot of the running process.  Constants stay
+ * inline in the code, which therefore doubles as the constant pool.
+ * The header records a format version and an FNV-1a hash and length of
+ * the source text; a file that does not match the source, or that fails
+ * any bounds or stack check, is ignored.  A snapshot written by SAVE
+ * has the same layout with an empty source and carries the values of
+ * the variables as well.  CACHE_VERSION must be raised whenever these
+ * records or the meaning of PostfixCode change.
+ */
+
+static const char CACHE_MAGIC[4] = {'B', 'A', 'S', 'C'};
+static const uint32_t CACHE_VERSION = 1;
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t sourceLength;
+    uint32_t lineCount;
+    uint32_t expCount;
+    uint32_t symbolCount;
+    uint32_t codeLength;
+    uint32_t textLength;
+    uint32_t varCount;
+};
+
+struct CachedText {
+    uint32_t offset;
+    uint32_t length;
+};
+
+/*
+ * Type: CachedLine
+ * ----------------
+ * One program line.  The meaning of the operands depends on the type:
+ * LET uses symbol and first; PRINT uses first; INPUT uses symbol; GOTO
+ * uses target; IF uses first, second, op and target.  Unused operands
+ * are -1.
+ */
+
+struct CachedLine {
+    int32_t lineNumber;
+    int32_t type;
+    int32_t symbol;
+    int32_t first;
+    int32_t second;
+    int32_t op;
+    int32_t target;
+    CachedText text;
+};
+
+struct CachedExp {
+    uint32_t offset;
+    uint32_t length;
+    uint32_t depth;
+};
+
+struct CachedVar {
+    int32_t symbol;
+    int32_t value;
+};
+
+static uint64_t hashSource(std::string_view source) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (char ch : source) {
+        hash = (hash ^ (unsigned char) ch) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool isSlotOperand(PostfixCode code) {
+    return code == PF_VAR || (code >= PF_ADD_VAR && code <= PF_DIV_VAR) || code == PF_ASSIGN;
+}
+
+std::string getCacheName(const std::string &filename) {
+    return filename + ".cache";
+}
+
+/*
+ * Implementation notes: saveProgramCache, saveSnapshot
+ * ----------------------------------------------------
+ * The sections are collected in memory and written to a temporary file
+ * that is renamed over the target, so a reader never sees a partly
+ * written file.  The temporary name is made unique by mkstemp in the
+ * directory of the target, so that two interpreters saving the same
+ * file cannot write into each other's temporary.  A program with an
+ * expression that is not in postfix form is not saved.
+ */
+
+namespace {
+
+class CacheWriter {
+
+public:
+
+    bool addProgram(Program &program) {
+        for (const Instruction &ins : program.compile()) {
+            CachedLine line = {ins.lineNumber, ins.type, -1, -1, -1, -1, -1, addText(*ins.source)};
+            switch (ins.type) {
+                case LET_STMT:
+                    line.symbol = addSymbol(((LetStatement *) ins.stmt)->getSlot());
+                    line.first = addExp(((LetStatement *) ins.stmt)->getExp());
+                    break;
+                case PRINT_STMT:
+                    line.first = addExp(((PrintStatement *) ins.stmt)->getExp());
+                    break;
+                case INPUT_STMT:
+                    line.symbol = addSymbol(((InputStatement *) ins.stmt)->getSlot());
+                    break;
+                case GOTO_STMT:
+                    line.target = ((GotoStatement *) ins.stmt)->getlinetarget();
+                    break;
+                case IF_STMT:
+                    line.first = addExp(((IfStatement *) ins.stmt)->getLHS());
+                    line.second = addExp(((IfStatement *) ins.stmt)->getRHS());
+                    line.op = ((IfStatement *) ins.stmt)->getOp();
+                    line.target = ((IfStatement *) ins.stmt)->get_target_line();
+                    break;
+                case REM_STMT:
+                case END_STMT:
+                    break;
+                default:
+                    return false;
+            }
+            if (line.first < -1 || line.second < -1) return false;
+            lines.push_back(line);
+        }
+        return true;
+    }
+
+    void addVariables(EvalState &state) {
+        for (int slot = 0; slot < EvalState::getSlotCount(); slot++) {
+            if (state.isDefined(slot)) {
+                vars.push_back({addSymbol(slot), state.getValue(slot)});
+            }
+        }
+    }
+
+    bool write(const std::string &filename, std::string_view source) {
+        CacheHeader header = {};
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.version = CACHE_VERSION;
+        header.sourceHash = hashSource(source);
+        header.sourceLength = source.length();
+        header.lineCount = lines.size();
+        header.expCount = exps.size();
+        header.symbolCount = symbols.size();
+        header.codeLength = code.size();
+        header.textLength = text.length();
+        header.varCount = vars.size();
+        std::string temp = filename + ".XXXXXX";
+        int fd = mkstemp(&temp[0]);
+        if (fd < 0) return false;
+        fchmod(fd, 0644);
+        FILE *file = fdopen(fd, "wb");
+        if (file == nullptr) {
+            close(fd);
+            remove(temp.c_str());
+            return false;
+        }
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+                  && writeSection(file, lines)
+                  && writeSection(file, exps)
+                  && writeSection(file, symbols)
+                  && writeSection(file, vars)
+                  && writeSection(file, code)
+                  && fwrite(text.data(), 1, text.length(), file) == text.length();
+        ok = fclose(file) == 0 && ok;
+        if (!ok || rename(temp.c_str(), filename.c_str()) != 0) {
+            remove(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+
+    std::vector<CachedLine> lines;
+    std::vector<CachedExp> exps;
+    std::vector<CachedText> symbols;
+    std::vector<CachedVar> vars;
+    std::vector<PostfixInstr> code;
+    std::string text;
+    std::vector<int> symbolOf;
+
+    CachedText addText(std::string_view str) {
+        CachedText entry = {(uint32_t) text.length(), (uint32_t) str.length()};
+        text.append(str);
+        return entry;
+    }
+
+    int addSymbol(int slot) {
+        if (slot < 0) return -1;
+        if (slot >= (int) symbolOf.size()) symbolOf.resize(slot + 1, -1);
+        if (symbolOf[slot] < 0) {
+            symbolOf[slot] = symbols.size();
+            symbols.push_back(addText(EvalState::getSlotName(slot)));
+        }
+        return symbolOf[slot];
+    }
+
+    int addExp(Expression *exp) {
+        if (exp->getType() != POSTFIX) return -2;
+        PostfixExp *postfix = (PostfixExp *) exp;
+        exps.push_back({(uint32_t) code.size(), (uint32_t) postfix->getLength(),
+                        (uint32_t) postfix->getDepth()});
+        for (int i = 0; i < postfix->getLength(); i++) {
+            PostfixInstr ins = postfix->getCode()[i];
+            if (isSlotOperand(ins.code)) ins.operand = addSymbol(ins.operand);
+            code.push_back(ins);
+        }
+        return exps.size() - 1;
+    }
+
+    template <typename T>
+    static bool writeSection(FILE *file, const std::vector<T> &section) {
+        return section.empty() || fwrite(section.data(), sizeof(T), section.size(), file) == section.size();
+    }
+
+};
+
+}
+
+bool saveProgramCache(const std::string &cache, std::string_view source, Program &program) {
+    CacheWriter writer;
+    return writer.addProgram(program) && writer.write(cache, source);
+}
+
+bool saveSnapshot(const std::string &filename, Program &program, EvalState &state) {
+    CacheWriter writer;
+    if (!writer.addProgram(program)) return false;
+    writer.addVariables(state);
+    return writer.write(filename, "");
+}
+
+/*
+ * Implementation notes: loadProgramCache, loadSnapshot
+ * ----------------------------------------------------
+ * The file is mapped read-only and checked completely before the
+ * program is touched: every index and text range must be in bounds,
+ * every postfix program must be well formed and its recorded depth
+ * must cover a simulation of its stack.  Restoring is then a single
+ * pass that copies all code into the program's arena at once,
+ * translating symbol indices into slots, and builds each statement in
+ * place from its record; a snapshot then stores its variable values
+ * straight into their slots.
+ */
+
+namespace {
+
+class CacheReader {
+
+public:
+
+    const CacheHeader *header;
+    const CachedLine *lines;
+    const CachedExp *exps;
+    const CachedText *symbols;
+    const CachedVar *vars;
+    const PostfixInstr *code;
+    const char *text;
+
+    CacheReader() : data(nullptr), size(0) {}
+
+    ~CacheReader() {
+        if (data != nullptr) munmap((void *) data, size);
+    }
+
+    bool open(const std::string &filename) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) < 0 || info.st_size < (off_t) sizeof(CacheHeader)) {
+            ::close(fd);
+            return false;
+        }
+        void *mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) return false;
+        data = (const char *) mapped;
+        size = info.st_size;
+        header = (const CacheHeader *) data;
+        if (std::memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+            || header->version != CACHE_VERSION) {
+            return false;
+        }
+        size_t offset = sizeof(CacheHeader);
+        lines = (const CachedLine *) (data + offset);
+        offset += header->lineCount * sizeof(CachedLine);
+        exps = (const CachedExp *) (data + offset);
+        offset += header->expCount * sizeof(CachedExp);
+        symbols = (const CachedText *) (data + offset);
+        offset += header->symbolCount * sizeof(CachedText);
+        vars = (const CachedVar *) (data + offset);
+        offset += header->varCount * sizeof(CachedVar);
+        code = (const PostfixInstr *) (data + offset);
+        offset += (size_t) header->codeLength * sizeof(PostfixInstr);
+        text = data + offset;
+        offset += header->textLength;
+        return offset == size && check();
+    }
+
+    bool matches(std::string_view source) {
+        return header->sourceLength == source.length() && header->sourceHash == hashSource(source);
+    }
+
+    void restore(Program &program, EvalState *state);
+
+private:
+
+    const char *data;
+    size_t size;
+
+    bool checkText(CachedText entry) {
+        return entry.offset <= header->textLength && entry.length <= header->textLength - entry.offset;
+    }
+
+    bool checkExp(int index) {
+        if (index < 0 || index >= (int) header->expCount) return false;
+        CachedExp exp = exps[index];
+        if (exp.offset > header->codeLength || exp.length > header->codeLength - exp.offset) return false;
+        int sp = 0;
+        int depth = 0;
+        for (uint32_t i = exp.offset; i < exp.offset + exp.length; i++) {
+            PostfixInstr ins = code[i];
+            if (ins.code < PF_CONST || ins.code > PF_ERROR) return false;
+            if (isSlotOperand(ins.code) && ins.operand >= (int) header->symbolCount) return false;
+            if (isSlotOperand(ins.code) && ins.code != PF_ASSIGN && ins.operand < 0) return false;
+            if (ins.code == PF_ERROR) {
+                if (ins.operand != 0 && ins.operand != 1) return false;
+            } else if (ins.code == PF_CONST || ins.code == PF_VAR) {
+                sp++;
+            } else if (ins.code == PF_ASSIGN) {
+                if (ins.operand < 0) {
+                    if (ins.operand != -1 || sp < 2) return false;
+                    sp--;
+                } else if (sp < 1) {
+                    return false;
+                }
+            } else if (ins.code >= PF_ADD && ins.code <= PF_DIV) {
+                if (sp < 2) return false;
+                sp--;
+            } else if (sp < 1) {
+                return false;
+            }
+            depth = std::max(depth, sp);
+        }
+        return sp == 1 && depth <= (int) exp.depth;
+    }
+
+    bool check() {
+        for (uint32_t i = 0; i < header->symbolCount; i++) {
+            if (!checkText(symbols[i]) || symbols[i].length == 0) return false;
+        }
+        for (uint32_t i = 0; i < header->varCount; i++) {
+            if (vars[i].symbol < 0 || vars[i].symbol >= (int) header->symbolCount) return false;
+        }
+        for (uint32_t i = 0; i < header->lineCount; i++) {
+            const CachedLine &line = lines[i];
+            if (!checkText(line.text)) return false;
+            if (i > 0 && line.lineNumber <= lines[i - 1].lineNumber) return false;
+            bool symbol = line.symbol >= 0 && line.symbol < (int) header->symbolCount;
+            switch (line.type) {
+                case LET_STMT:
+                    if (!symbol || !checkExp(line.first)) return false;
+                    break;
+                case PRINT_STMT:
+                    if (!checkExp(line.first)) return false;
+                    break;
+                case INPUT_STMT:
+                    if (!symbol) return false;
+                    break;
+                case IF_STMT:
+                    if (!checkExp(line.first) || !checkExp(line.second)) return false;
+                    if (line.op != '=' && line.op != '<' && line.op != '>') return false;
+                    break;
+                case REM_STMT:
+                case END_STMT:
+                case GOTO_STMT:
+                    break;
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+};
+
+}
+
+void CacheReader::restore(Program &program, EvalState *state) {
+    std::vector<int> slots(header->symbolCount);
+    std::vector<std::string> names(header->symbolCount);
+    for (uint32_t i = 0; i < header->symbolCount; i++) {
+        names[i].assign(text + symbols[i].offset, symbols[i].length);
+        slots[i] = EvalState::getSlot(names[i]);
+    }
+    Arena &arena = program.getArena();
+    PostfixInstr *copy = static_cast<PostfixInstr *>(
+            arena.allocate(header->codeLength * sizeof(PostfixInstr), alignof(PostfixInstr)));
+    std::memcpy(copy, code, header->codeLength * sizeof(PostfixInstr));
+    for (uint32_t i = 0; i < header->codeLength; i++) {
+        if (isSlotOperand(copy[i].code) && copy[i].operand >= 0) copy[i].operand = slots[copy[i].operand];
+    }
+    std::vector<Expression *> built(header->expCount);
+    for (uint32_t i = 0; i < header->expCount; i++) {
+        built[i] = new (arena) PostfixExp(copy + exps[i].offset, exps[i].length, exps[i].depth);
+    }
+    for (uint32_t i = 0; i < header->lineCount; i++) {
+        const CachedLine &line = lines[i];
+        Statement *stmt;
+        switch (line.type) {
+            case LET_STMT:
+                stmt = new (arena) LetStatement(names[line.symbol], built[line.first]);
+                break;
+            case PRINT_STMT:
+                stmt = new (arena) PrintStatement(built[line.first]);
+                break;
+            case INPUT_STMT:
+                stmt = new (arena) InputStatement(names[line.symbol]);
+                break;
+            case GOTO_STMT:
+                stmt = new (arena) GotoStatement(line.target);
+                break;
+            case IF_STMT:
+                stmt = new (arena) IfStatement(built[line.first], built[line.second], (char) line.op, line.target);
+                break;
+            case END_STMT:
+                stmt = new (arena) EndStatement();
+                break;
+            default:
+                stmt = new (arena) REMStatement();
+                break;
+        }
+        program.addParsedLine(line.lineNumber, std::string(text + line.text.offset, line.text.length),
+                              stmt);
+    }
+    if (state != nullptr) {
+        for (uint32_t i = 0; i < header->varCount; i++) {
+            state->setValue(slots[vars[i].symbol], vars[i].value);
+        }
+    }
+}
+
+bool loadProgramCache(const std::string &cache, std::string_view source, Program &program) {
+    CacheReader reader;
+    if (!reader.open(cache) || !reader.matches(source)) return false;
+    reader.restore(program, nullptr);
+    return true;
+}
+
+bool loadSnapshot(const std::string &filename, Program &program, EvalState &state) {
+    CacheReader reader;
+    if (!reader.open(filename)) return false;
+    program.clear();
+    state.Clear();
+    reader.restore(program, &state);
+    return true;
+}
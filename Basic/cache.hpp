@@ -0,0 +1,76 @@
+/*
+ * File: cache.h
+ * -------------
+ * This interface exports functions that store the compiled form of a
+ * program on disk, either as a cache for a source file or as a SAVE
+ * snapshot that includes the variables, and restore it without parsing
+ * the source again.
+ */
+
+#ifndef _cache_h
+#define _cache_h
+
+#include <string>
+#include <string_view>
+#include "program.hpp"
+
+/*
+ * Function: getCacheName
+ * Usage: std::string cache = getCacheName(filename);
+ * --------------------------------------------------
+ * Returns the name of the cache file kept next to the named source
+ * file.
+ */
+
+std::string getCacheName(const std::string &filename);
+
+/*
+ * Function: loadProgramCache
+ * Usage: if (loadProgramCache(cache, source, program)) ...
+ * --------------------------------------------------------
+ * Restores the lines of the program from the named cache file and
+ * returns true.  The file is used only if it was written by this
+ * version of the interpreter for exactly the given source text and
+ * passes every consistency check; otherwise the function leaves the
+ * program untouched and returns false, and the caller parses the
+ * source instead.  The program must be empty.
+ */
+
+bool loadProgramCache(const std::string &cache, std::string_view source, Program &program);
+
+/*
+ * Function: saveProgramCache
+ * Usage: saveProgramCache(cache, source, program);
+ * ------------------------------------------------
+ * Writes the compiled form of the program, which must have been loaded
+ * from the given source text, to the named cache file.  Returns false
+ * if the file cannot be written; the program is not affected either
+ * way.
+ */
+
+bool saveProgramCache(const std::string &cache, std::string_view source, Program &program);
+
+/*
+ * Function: saveSnapshot
+ * Usage: if (saveSnapshot(filename, program, state)) ...
+ * ------------------------------------------------------
+ * Writes the program, in the same compiled form as the cache, together
+ * with the value of every defined variable to the named file.  Returns
+ * false if the file cannot be written.
+ */
+
+bool saveSnapshot(const std::string &filename, Program &program, EvalState &state);
+
+/*
+ * Function: loadSnapshot
+ * Usage: if (loadSnapshot(filename, program, state)) ...
+ * ------------------------------------------------------
+ * Replaces the program and all variable values with the contents of a
+ * snapshot written by saveSnapshot, without parsing any text, and
+ * returns true.  If the file cannot be read or is not a valid snapshot,
+ * nothing is changed and the function returns false.
+ */
+
+bool loadSnapshot(const std::string &filename, Program &program, EvalState &state);
+
+#endif
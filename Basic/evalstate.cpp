@@ -7,6 +7,8 @@
  */
 
 
+#include <algorithm>
+#include <mutex>
 #include "evalstate.hpp"
 
 
@@ -14,7 +16,11 @@
 
 /* Implementation of the EvalState class */
 
-EvalState::EvalState() {
+std::unordered_map<std::string, int> EvalState::slotTable;
+std::vector<std::string> EvalState::slotNames;
+std::shared_mutex EvalState::slotLock;
+
+EvalState::EvalState() : engine(TREE_WALKER) {
     /* Empty */
 }
 
@@ -22,20 +28,80 @@ EvalState::~EvalState() {
     /* Empty */
 }
 
-void EvalState::setValue(std::string var, int value) {
-    if(isDefined(var)) symbolTable[var] = value;
-    else symbolTable.emplace(var,value);
+void EvalState::setValue(const std::string &var, int value) {
+    setValue(getSlot(var), value);
 }
 
-int EvalState::getValue(std::string var) {
-    if(isDefined(var)) return symbolTable[var];
-    else return 0;
+int EvalState::getValue(const std::string &var) {
+    auto ff = slotTable.find(var);
+    if (ff == slotTable.end()) return 0;
+    return getValue(ff->second);
 }
 
-bool EvalState::isDefined(std::string var) {
-    return symbolTable.find(var)!=symbolTable.end();
+bool EvalState::isDefined(const std::string &var) {
+    auto ff = slotTable.find(var);
+    return ff != slotTable.end() && isDefined(ff->second);
 }
 
 void EvalState::Clear() {
-    symbolTable.clear();
-}
\ No newline at end of file
+    std::fill(values.begin(), values.end(), 0);
+    std::fill(defined.begin(), defined.end(), 0);
+}
+
+/*
+ * Implementation notes: getSlot
+ * -----------------------------
+ * Names are almost always found, so lookups share the lock and only an
+ * insertion takes it exclusively, checking again for a name another
+ * thread added in between.
+ */
+
+int EvalState::getSlot(const std::string &var) {
+    {
+        std::shared_lock<std::shared_mutex> lock(slotLock);
+        auto ff = slotTable.find(var);
+        if (ff != slotTable.end()) return ff->second;
+    }
+    std::unique_lock<std::shared_mutex> lock(slotLock);
+    auto ff = slotTable.find(var);
+    if (ff != slotTable.end()) return ff->second;
+    int slot = slotNames.size();
+    slotTable.emplace(var, slot);
+    slotNames.push_back(var);
+    return slot;
+}
+
+const std::string &EvalState::getSlotName(int slot) {
+    return slotNames[slot];
+}
+
+int EvalState::getSlotCount() {
+    return slotNames.size();
+}
+
+void EvalState::setEngine(ExecutionEngine engine) {
+    this->engine = engine;
+}
+
+ExecutionEngine EvalState::getEngine() {
+    return engine;
+}
+
+void EvalState::getStorage(int *&values, uint64_t *&defined) {
+    if (this->values.size() < slotNames.size()) grow(slotNames.size() - 1);
+    values = this->values.data();
+    defined = this->defined.data();
+}
+
+/*
+ * Implementation notes: grow
+ * --------------------------
+ * Extends the value array to cover every slot interned so far, so that
+ * a run of new variables costs a single reallocation.
+ */
+
+void EvalState::grow(int slot) {
+    int size = std::max(slot + 1, (int) slotNames.size());
+    values.resize(size, 0);
+    defined.resize((size + 63) / 64, 0);
+}
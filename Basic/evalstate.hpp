@@ -9,8 +9,24 @@
 #ifndef _evalstate_h
 #define _evalstate_h
 
+#include <cstdint>
+#include <shared_mutex>
 #include <string>
-#include <map>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Type: ExecutionEngine
+ * ---------------------
+ * This enumerated type selects how RUN executes a program: by walking
+ * the compiled statements (TREE_WALKER), by lowering the program
+ * into direct-threaded code (THREADED) or by translating it into native
+ * code (JIT).
+ */
+
+enum ExecutionEngine {
+    TREE_WALKER, THREADED, JIT
+};
 
 /*
  * Class: EvalState
@@ -20,8 +36,15 @@
  * environment that the evaluator may need to know.  In this
  * version, the only information maintained by the EvalState class
  * is a symbol table that maps variable names into their values.
- * In your implementation, you may include additional information
- * in the EvalState class.
+ *
+ * Variable names are interned once into dense integer slots that are
+ * shared by every EvalState in the process.  The parser resolves each
+ * identifier to its slot, so the evaluator reads and writes variables
+ * by indexing a flat array of values and a bitmap of defined slots.
+ * The name-based methods remain available for INPUT and immediate
+ * mode and simply go through the same slots.
+ *
+ * The state also records which execution engine RUN should use.
  */
 
 class EvalState {
@@ -49,36 +72,138 @@ public:
 /*
  * Method: setValue
  * Usage: state.setValue(var, value);
+ *        state.setValue(slot, value);
  * ----------------------------------
  * Sets the value associated with the specified var.
  */
 
-    void setValue(std::string var, int value);
+    void setValue(const std::string &var, int value);
+
+    void setValue(int slot, int value);
 
 /*
  * Method: getValue
  * Usage: int value = state.getValue(var);
+ *        int value = state.getValue(slot);
  * ---------------------------------------
- * Returns the value associated with the specified variable.
+ * Returns the value associated with the specified variable, or 0 if
+ * the variable is not defined.
  */
 
-    int getValue(std::string var);
+    int getValue(const std::string &var);
+
+    int getValue(int slot);
 
 /*
  * Method: isDefined
  * Usage: if (state.isDefined(var)) . . .
+ *        if (state.isDefined(slot)) . . .
  * --------------------------------------
  * Returns true if the specified variable is defined.
  */
 
-    bool isDefined(std::string var);
+    bool isDefined(const std::string &var);
+
+    bool isDefined(int slot);
+
+/*
+ * Method: Clear
+ * Usage: state.Clear();
+ * ---------------------
+ * Removes all variable bindings.  Slots stay allocated, so parsed
+ * statements that refer to them remain valid.
+ */
 
     void Clear();
 
+/*
+ * Method: getSlot
+ * Usage: int slot = EvalState::getSlot(var);
+ * ------------------------------------------
+ * Returns the slot assigned to the specified variable name, assigning
+ * the next free slot if the name has not been seen before.  This is
+ * the only slot method that may be called from several threads at
+ * once, which is what lets program lines be parsed in parallel.
+ */
+
+    static int getSlot(const std::string &var);
+
+/*
+ * Method: getSlotName
+ * Usage: std::string name = EvalState::getSlotName(slot);
+ * -------------------------------------------------------
+ * Returns the variable name that was assigned the specified slot.
+ */
+
+    static const std::string &getSlotName(int slot);
+
+/*
+ * Method: getSlotCount
+ * Usage: int count = EvalState::getSlotCount();
+ * ---------------------------------------------
+ * Returns the number of slots assigned so far.
+ */
+
+    static int getSlotCount();
+
+/*
+ * Methods: setEngine, getEngine
+ * Usage: state.setEngine(THREADED);
+ *        ExecutionEngine engine = state.getEngine();
+ * ------------------------------------------------
+ * Sets and returns the engine used by RUN.  The default is TREE_WALKER.
+ */
+
+    void setEngine(ExecutionEngine engine);
+
+    ExecutionEngine getEngine();
+
+/*
+ * Method: getStorage
+ * Usage: state.getStorage(values, defined);
+ * -----------------------------------------
+ * Returns the value array and the definition bitmap, grown to cover
+ * every slot interned so far.  The pointers stay valid until a new
+ * slot is interned; generated code uses them to access variables
+ * without going through setValue and getValue.
+ */
+
+    void getStorage(int *&values, uint64_t *&defined);
+
 private:
 
-    std::map<std::string, int> symbolTable;
+    std::vector<int> values;             /* Value of each slot           */
+    std::vector<uint64_t> defined;       /* Bitmap of slots with a value */
+    ExecutionEngine engine;              /* Engine used by RUN           */
+
+    static std::unordered_map<std::string, int> slotTable;
+    static std::vector<std::string> slotNames;
+    static std::shared_mutex slotLock;   /* Guards getSlot across threads */
+
+    void grow(int slot);
 
 };
 
+/*
+ * Implementation notes: slot access
+ * ---------------------------------
+ * The slot-based methods are on the innermost path of every variable
+ * reference, so they are defined inline here rather than in
+ * evalstate.cpp.
+ */
+
+inline bool EvalState::isDefined(int slot) {
+    return slot < (int) values.size() && (defined[slot >> 6] >> (slot & 63) & 1);
+}
+
+inline int EvalState::getValue(int slot) {
+    return isDefined(slot) ? values[slot] : 0;
+}
+
+inline void EvalState::setValue(int slot, int value) {
+    if (slot >= (int) values.size()) grow(slot);
+    values[slot] = value;
+    defined[slot >> 6] |= uint64_t(1) << (slot & 63);
+}
+
 #endif
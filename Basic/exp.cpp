@@ -4,16 +4,20 @@
  * This file implements the Expression class and its subclasses.
  */
 
+#include <algorithm>
+#include <memory>
 #include "exp.hpp"
+#include "output.hpp"
 
 
 /*
  * Implementation notes: the Expression class
  * ------------------------------------------
- * The Expression class declares no instance variables and needs no code.
+ * The Expression class declares only the type tag of the node, which
+ * each subclass passes to the base constructor.
  */
 
-Expression::Expression() = default;
+Expression::Expression(ExpressionType type) : type(type) {}
 
 Expression::~Expression() = default;
 
@@ -25,7 +29,7 @@ Expression::~Expression() = default;
  * value of state but needs it to match the general prototype for eval.
  */
 
-ConstantExp::ConstantExp(int value) {
+ConstantExp::ConstantExp(int value) : Expression(CONSTANT) {
     this->value = value;
 }
 
@@ -37,10 +41,6 @@ std::string ConstantExp::toString() {
     return integerToString(value);
 }
 
-ExpressionType ConstantExp::getType() {
-    return CONSTANT;
-}
-
 int ConstantExp::getValue() {
     return value;
 }
@@ -48,52 +48,114 @@ int ConstantExp::getValue() {
 /*
  * Implementation notes: the IdentifierExp subclass
  * ------------------------------------------------
- * The IdentifierExp subclass declares a single instance variable that
- * stores the name of the variable.  The implementation of eval must
- * look this variable up in the evaluation state.
+ * The IdentifierExp subclass stores the name of the variable together
+ * with the slot it was interned to.  The implementation of eval looks
+ * the slot up in the evaluation state, which is a direct array access.
  */
 
-IdentifierExp::IdentifierExp(std::string name) {
+IdentifierExp::IdentifierExp(std::string name) : Expression(IDENTIFIER) {
     this->name = name;
+    this->slot = EvalState::getSlot(name);
 }
 
 int IdentifierExp::eval(EvalState &state) {
-    if (!state.isDefined(name)) {
-        std::cout << "VARIABLE NOT DEFINED" << std::endl;
+    if (!state.isDefined(slot)) {
+        Output::writeLine("VARIABLE NOT DEFINED");
         return 114514;
     }
-    return state.getValue(name);
+    return state.getValue(slot);
 }
 
 std::string IdentifierExp::toString() {
     return name;
 }
 
-ExpressionType IdentifierExp::getType() {
-    return IDENTIFIER;
-}
-
 std::string IdentifierExp::getName() {
     return name;
 }
 
+int IdentifierExp::getSlot() {
+    return slot;
+}
+
 /*
  * Implementation notes: the CompoundExp subclass
  * ----------------------------------------------
  * The CompoundExp subclass declares instance variables for the operator
- * and the left and right subexpressions.  The implementation of eval 
- * evaluates the subexpressions recursively and then applies the operator.
+ * and the left and right subexpressions.  The operator token is also
+ * translated into an OperatorType when the node is built.  The
+ * implementation of eval evaluates the subexpressions recursively and
+ * then applies the operator.
  */
 
-CompoundExp::CompoundExp(std::string op, Expression *lhs, Expression *rhs) {
+CompoundExp::CompoundExp(std::string op, Expression *lhs, Expression *rhs) : Expression(COMPOUND) {
     this->op = op;
     this->lhs = lhs;
     this->rhs = rhs;
+    if (op == "=") opType = OP_ASSIGN;
+    else if (op == "+") opType = OP_ADD;
+    else if (op == "-") opType = OP_SUB;
+    else if (op == "*") opType = OP_MUL;
+    else if (op == "/") opType = OP_DIV;
+    else opType = OP_UNKNOWN;
 }
 
+/*
+ * Implementation notes: ~CompoundExp
+ * ----------------------------------
+ * Compound operands are detached and freed from a worklist rather than
+ * by recursive destructor calls, so that freeing a deeply nested tree
+ * cannot overflow the call stack.
+ */
+
 CompoundExp::~CompoundExp() {
-    delete lhs;
-    delete rhs;
+    if ((lhs == nullptr || lhs->getType() != COMPOUND) && (rhs == nullptr || rhs->getType() != COMPOUND)) {
+        delete lhs;
+        delete rhs;
+        return;
+    }
+    std::vector<Expression *> pending = {lhs, rhs};
+    while (!pending.empty()) {
+        Expression *exp = pending.back();
+        pending.pop_back();
+        if (exp != nullptr && exp->getType() == COMPOUND) {
+            CompoundExp *node = (CompoundExp *) exp;
+            pending.push_back(node->lhs);
+            pending.push_back(node->rhs);
+            node->lhs = nullptr;
+            node->rhs = nullptr;
+        }
+        delete exp;
+    }
+}
+
+/*
+ * Implementation notes: evalOperand
+ * ---------------------------------
+ * Evaluates a subexpression of a compound node.  Constants and
+ * identifiers are handled inline, and nested compound nodes are
+ * evaluated through a direct call, so walking a tree built by the
+ * parser needs no virtual dispatch.  Any other kind of node falls back
+ * to its virtual eval method.
+ */
+
+static inline int evalOperand(Expression *exp, EvalState &state) {
+    switch (exp->getType()) {
+        case CONSTANT:
+            return ((ConstantExp *) exp)->getValue();
+        case IDENTIFIER: {
+            int slot = ((IdentifierExp *) exp)->getSlot();
+            if (!state.isDefined(slot)) {
+                Output::writeLine("VARIABLE NOT DEFINED");
+                return 114514;
+            }
+            return state.getValue(slot);
+        }
+        case COMPOUND:
+            return ((CompoundExp *) exp)->CompoundExp::eval(state);
+        default:
+            return exp->eval(state);
+    }
 }
 
 /*
@@ -105,43 +167,50 @@ CompoundExp::~CompoundExp() {
  */
 
 int CompoundExp::eval(EvalState &state) {
-    if (op == "=") {
+    static const int letSlot = EvalState::getSlot("LET");
+    if (opType == OP_ASSIGN) {
         if (lhs->getType() != IDENTIFIER) {
             error("Illegal variable in assignment");
         }
-        if (lhs->getType() == IDENTIFIER && lhs->toString() == "LET")
+        int slot = ((IdentifierExp *) lhs)->getSlot();
+        if (slot == letSlot)
             error("SYNTAX ERROR");
-        int val = rhs->eval(state);
-        state.setValue(((IdentifierExp *) lhs)->getName(), val);
+        int val = evalOperand(rhs, state);
+        state.setValue(slot, val);
         return val;
     }
-    int left = lhs->eval(state);
-    int right = rhs->eval(state);
-    if (op == "+") return left + right;
-    if (op == "-") return left - right;
-    if (op == "*") return left * right;
-    if (op == "/") {
-        if (right == 0) {
-            std::cout << "DIVIDE BY ZERO" << std::endl;
-            return 114514;
-        }
-        return left / right;
+    int left = evalOperand(lhs, state);
+    int right = evalOperand(rhs, state);
+    switch (opType) {
+        case OP_ADD:
+            return left + right;
+        case OP_SUB:
+            return left - right;
+        case OP_MUL:
+            return left * right;
+        case OP_DIV:
+            if (right == 0) {
+                Output::writeLine("DIVIDE BY ZERO");
+                return 114514;
+            }
+            return left / right;
+        default:
+            return 0;
     }
-    return 0;
 }
 
 std::string CompoundExp::toString() {
     return '(' + lhs->toString() + ' ' + op + ' ' + rhs->toString() + ')';
 }
 
-ExpressionType CompoundExp::getType() {
-    return COMPOUND;
-}
-
 std::string CompoundExp::getOp() {
     return op;
 }
 
+OperatorType CompoundExp::getOpType() {
+    return opType;
+}
+
 Expression *CompoundExp::getLHS() {
     return lhs;
 }
@@ -149,3 +218,304 @@ Expression *CompoundExp::getLHS() {
 Expression *CompoundExp::getRHS() {
     return rhs;
 }
+
+void CompoundExp::setOperands(Expression *lhs, Expression *rhs) {
+    this->lhs = lhs;
+    this->rhs = rhs;
+}
+
+/*
+ * Implementation notes: the PostfixExp subclass
+ * ---------------------------------------------
+ * The constructor walks the tree in postorder with an explicit stack,
+ * so flattening does not depend on the depth of the tree.  Each entry
+ * records whether the children of the node have already been pushed.
+ * An assignment whose target is not a plain variable is flattened to
+ * PF_ERROR followed by both operands and a PF_ASSIGN with slot -1;
+ * eval stops at PF_ERROR, and toString uses the operands to rebuild
+ * the text of the assignment.
+ *
+ * The code of a right operand ends immediately before its operator, so
+ * if the last instruction emitted is a single push, that push is the
+ * whole right operand and emitBinary merges it into the operator.
+ *
+ * The program is assembled in a scratch buffer that is reused across
+ * calls and then copied into the arena in one piece.
+ */
+
+const char *const POSTFIX_ERRORS[] = {
+    "Illegal variable in assignment",
+    "SYNTAX ERROR"
+};
+
+static void emitBinary(std::vector<PostfixInstr> &code, PostfixCode op) {
+    PostfixInstr &last = code.back();
+    if (last.code == PF_CONST) {
+        last.code = PostfixCode(op - PF_ADD + PF_ADD_CONST);
+    } else if (last.code == PF_VAR) {
+        last.code = PostfixCode(op - PF_ADD + PF_ADD_VAR);
+    } else {
+        code.push_back({op, 0});
+    }
+}
+
+
+PostfixExp::PostfixExp(Expression *tree, Arena &arena) : Expression(POSTFIX) {
+    static const int letSlot = EvalState::getSlot("LET");
+    static thread_local std::vector<PostfixInstr> out;
+    static thread_local std::vector<std::pair<Expression *, bool>> pending;
+    out.clear();
+    pending.clear();
+    pending.emplace_back(tree, false);
+    int sp = 0;
+    depth = 0;
+    while (!pending.empty()) {
+        Expression *exp = pending.back().first;
+        bool expanded = pending.back().second;
+        pending.pop_back();
+        switch (exp->getType()) {
+            case CONSTANT:
+                out.push_back({PF_CONST, ((ConstantExp *) exp)->getValue()});
+                sp++;
+                break;
+            case IDENTIFIER:
+                out.push_back({PF_VAR, ((IdentifierExp *) exp)->getSlot()});
+                sp++;
+                break;
+            case POSTFIX:
+                out.insert(out.end(), ((PostfixExp *) exp)->getCode(),
+                           ((PostfixExp *) exp)->getCode() + ((PostfixExp *) exp)->getLength());
+                depth = std::max(depth, sp + ((PostfixExp *) exp)->getDepth());
+                sp++;
+                break;
+            case COMPOUND: {
+                CompoundExp *cmp = (CompoundExp *) exp;
+                OperatorType opType = cmp->getOpType();
+                if (expanded) {
+                    switch (opType) {
+                        case OP_ASSIGN:
+                            if (cmp->getLHS()->getType() != IDENTIFIER) {
+                                out.push_back({PF_ASSIGN, -1});
+                                sp--;
+                            } else {
+                                out.push_back({PF_ASSIGN, ((IdentifierExp *) cmp->getLHS())->getSlot()});
+                            }
+                            break;
+                        case OP_ADD:
+                            emitBinary(out, PF_ADD);
+                            sp--;
+                            break;
+                        case OP_SUB:
+                            emitBinary(out, PF_SUB);
+                            sp--;
+                            break;
+                        case OP_MUL:
+                            emitBinary(out, PF_MUL);
+                            sp--;
+                            break;
+                        case OP_DIV:
+                            emitBinary(out, PF_DIV);
+                            sp--;
+                            break;
+                        default:
+                            error("Illegal operator in expression");
+                    }
+                    break;
+                }
+                pending.emplace_back(exp, true);
+                if (opType == OP_ASSIGN) {
+                    Expression *lhs = cmp->getLHS();
+                    if (lhs->getType() != IDENTIFIER) {
+                        out.push_back({PF_ERROR, 0});
+                        pending.emplace_back(cmp->getRHS(), false);
+                        pending.emplace_back(lhs, false);
+                    } else {
+                        if (((IdentifierExp *) lhs)->getSlot() == letSlot) {
+                            out.push_back({PF_ERROR, 1});
+                        }
+                        pending.emplace_back(cmp->getRHS(), false);
+                    }
+                } else {
+                    pending.emplace_back(cmp->getRHS(), false);
+                    pending.emplace_back(cmp->getLHS(), false);
+                }
+                break;
+            }
+        }
+        depth = std::max(depth, sp);
+    }
+    length = out.size();
+    PostfixInstr *buffer = static_cast<PostfixInstr *>(arena.allocate(length * sizeof(PostfixInstr),
+                                                                      alignof(PostfixInstr)));
+    std::copy(out.begin(), out.end(), buffer);
+    code = buffer;
+}
+
+/*
+ * Implementation notes: eval
+ * --------------------------
+ * Expressions that fit in a small fixed stack are evaluated without
+ * touching the heap.  Undefined variables and division by zero print
+ * their message and yield the same marker value as the tree evaluator;
+ * those paths are kept out of line so that the dispatch loop stays
+ * small.  Every program begins with a push, but the compiler cannot
+ * see that, so the slot returned is cleared before the loop rather
+ * than the whole stack.
+ */
+
+static int undefinedVariable() {
+    Output::writeLine("VARIABLE NOT DEFINED");
+    return 114514;
+}
+
+static int divideByZero() {
+    Output::writeLine("DIVIDE BY ZERO");
+    return 114514;
+}
+
+static inline int readVariable(EvalState &state, int slot) {
+    return state.isDefined(slot) ? state.getValue(slot) : undefinedVariable();
+}
+
+int PostfixExp::eval(EvalState &state) {
+    int local[32];
+    local[0] = 0;
+    std::unique_ptr<int[]> heap;
+    int *stack = local;
+    if (depth > 32) {
+        heap.reset(new int[depth]);
+        stack = heap.get();
+    }
+    int sp = 0;
+    const PostfixInstr *ins = code;
+    const PostfixInstr *end = code + length;
+    for (; ins != end; ins++) {
+        switch (ins->code) {
+            case PF_CONST:
+                stack[sp++] = ins->operand;
+                break;
+            case PF_VAR:
+                stack[sp++] = readVariable(state, ins->operand);
+                break;
+            case PF_ADD:
+                sp--;
+                stack[sp - 1] = stack[sp - 1] + stack[sp];
+                break;
+            case PF_SUB:
+                sp--;
+                stack[sp - 1] = stack[sp - 1] - stack[sp];
+                break;
+            case PF_MUL:
+                sp--;
+                stack[sp - 1] = stack[sp - 1] * stack[sp];
+                break;
+            case PF_DIV:
+                sp--;
+                stack[sp - 1] = stack[sp] == 0 ? divideByZero() : stack[sp - 1] / stack[sp];
+                break;
+            case PF_ADD_CONST:
+                stack[sp - 1] = stack[sp - 1] + ins->operand;
+                break;
+            case PF_SUB_CONST:
+                stack[sp - 1] = stack[sp - 1] - ins->operand;
+                break;
+            case PF_MUL_CONST:
+                stack[sp - 1] = stack[sp - 1] * ins->operand;
+                break;
+            case PF_DIV_CONST:
+                stack[sp - 1] = ins->operand == 0 ? divideByZero() : stack[sp - 1] / ins->operand;
+                break;
+            case PF_ADD_VAR:
+                stack[sp - 1] = stack[sp - 1] + readVariable(state, ins->operand);
+                break;
+            case PF_SUB_VAR:
+                stack[sp - 1] = stack[sp - 1] - readVariable(state, ins->operand);
+                break;
+            case PF_MUL_VAR:
+                stack[sp - 1] = stack[sp - 1] * readVariable(state, ins->operand);
+                break;
+            case PF_DIV_VAR: {
+                int right = readVariable(state, ins->operand);
+                stack[sp - 1] = right == 0 ? divideByZero() : stack[sp - 1] / right;
+                break;
+            }
+            case PF_ASSIGN:
+                state.setValue(ins->operand, stack[sp - 1]);
+                break;
+            case PF_ERROR:
+                error(POSTFIX_ERRORS[ins->operand]);
+        }
+    }
+    return stack[0];
+}
+
+std::string PostfixExp::toString() {
+    std::vector<std::string> stack;
+    for (int i = 0; i < length; i++) {
+        const PostfixInstr &ins = code[i];
+        std::string rhs;
+        switch (ins.code) {
+            case PF_CONST:
+                stack.push_back(integerToString(ins.operand));
+                break;
+            case PF_VAR:
+                stack.push_back(EvalState::getSlotName(ins.operand));
+                break;
+            case PF_ADD:
+            case PF_SUB:
+            case PF_MUL:
+            case PF_DIV:
+                rhs = stack.back();
+                stack.pop_back();
+                stack.back() = '(' + stack.back() + ' ' + "+-*/"[ins.code - PF_ADD] + ' ' + rhs + ')';
+                break;
+            case PF_ADD_CONST:
+            case PF_SUB_CONST:
+            case PF_MUL_CONST:
+            case PF_DIV_CONST:
+                rhs = integerToString(ins.operand);
+                stack.back() = '(' + stack.back() + ' ' + "+-*/"[ins.code - PF_ADD_CONST] + ' ' + rhs + ')';
+                break;
+            case PF_ADD_VAR:
+            case PF_SUB_VAR:
+            case PF_MUL_VAR:
+            case PF_DIV_VAR:
+                rhs = EvalState::getSlotName(ins.operand);
+                stack.back() = '(' + stack.back() + ' ' + "+-*/"[ins.code - PF_ADD_VAR] + ' ' + rhs + ')';
+                break;
+            case PF_ASSIGN:
+                if (ins.operand == -1) {
+                    rhs = stack.back();
+                    stack.pop_back();
+                    stack.back() = '(' + stack.back() + " = " + rhs + ')';
+                } else {
+                    stack.back() = '(' + EvalState::getSlotName(ins.operand) + " = " + stack.back() + ')';
+                }
+                break;
+            case PF_ERROR:
+                break;
+        }
+    }
+    return stack.back();
+}
+
+PostfixExp::PostfixExp(const PostfixInstr *code, int length, int depth)
+        : Expression(POSTFIX), code(code), length(length), depth(depth) {}
+
+const PostfixInstr *PostfixExp::getCode() {
+    return code;
+}
+
+int PostfixExp::getLength() {
+    return length;
+}
+
+int PostfixExp::getDepth() {
+    return depth;
+}
+
+Expression *compileExp(Expression *tree, Arena &arena) {
+    Expression *exp = new (arena) PostfixExp(tree, arena);
+    delete tree;
+    return exp;
+}
@@ -10,19 +10,33 @@
 #define _exp_h
 
 #include <string>
+#include <vector>
 #include "Utils/error.hpp"
+#include "arena.hpp"
 #include "evalstate.hpp"
 #include "Utils/strlib.hpp"
 
 /*
  * Type: ExpressionType
  * --------------------
- * This enumerated type is used to differentiate the three different
- * expression types: CONSTANT, IDENTIFIER, and COMPOUND.
+ * This enumerated type is used to differentiate the four different
+ * expression types: CONSTANT, IDENTIFIER, COMPOUND, and POSTFIX.
  */
 
 enum ExpressionType {
-    CONSTANT, IDENTIFIER, COMPOUND
+    CONSTANT, IDENTIFIER, COMPOUND, POSTFIX
+};
+
+/*
+ * Type: OperatorType
+ * ------------------
+ * This enumerated type identifies the operator of a CompoundExp.  The
+ * operator token is translated once when the node is built, so that
+ * evaluation can switch on it instead of comparing strings.
+ */
+
+enum OperatorType {
+    OP_ASSIGN, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_UNKNOWN
 };
 
 /*
@@ -31,12 +45,13 @@ enum ExpressionType {
  * This class is used to represent a node in an expression tree.
  * Expression is an example of an abstract class, which defines
  * the structure and behavior of a set of classes but has no
- * objects of its own.  Any object must be one of the three
+ * objects of its own.  Any object must be one of the four
  * concrete subclasses of Expression:
  *
  *  1. ConstantExp   -- an integer constant
  *  2. IdentifierExp -- a string representing an identifier
  *  3. CompoundExp   -- two expressions combined by an operator
+ *  4. PostfixExp    -- an expression tree flattened into postfix form
  *
  * The Expression class defines the interface common to all
  * Expression objects; each subclass provides its own specific
@@ -55,11 +70,11 @@ public:
 /*
  * Constructor: Expression
  * -----------------------
- * The base class constructor is empty.  Each subclass must provide
- * its own constructor.
+ * The base class constructor records the type of the expression.
+ * Each subclass must provide its own constructor.
  */
 
-    Expression();
+    explicit Expression(ExpressionType type);
 
 /*
  * Destructor: ~Expression
@@ -95,11 +110,19 @@ public:
  * Method: type
  * Usage: ExpressionType type = exp->getType();
  * --------------------------------------------
- * Returns the type of the expression, which must be one of the constants
- * CONSTANT, IDENTIFIER, or COMPOUND.
+ * Returns the type of the expression, which must be one of the
+ * constants CONSTANT, IDENTIFIER, COMPOUND, or POSTFIX.  The type is
+ * stored in the base class, so this method is not virtual and lets the
+ * evaluator inspect a node without an indirect call.
  */
 
-    virtual ExpressionType getType() = 0;
+    ExpressionType getType() const {
+        return type;
+    }
+
+private:
+
+    const ExpressionType type;
 
 };
 
@@ -134,8 +157,6 @@ public:
 
     virtual std::string toString();
 
-    virtual ExpressionType getType();
-
 /*
  * Method: getValue
  * Usage: int value = ((ConstantExp *) exp)->getValue();
@@ -167,7 +188,8 @@ public:
  * Usage: Expression *exp = new IdentifierExp(name);
  * -------------------------------------------------
  * The constructor initializes a new identifier expression
- * for the variable named by name.
+ * for the variable named by name and resolves the name to its
+ * variable slot in the EvalState symbol table.
  */
 
     IdentifierExp(std::string name);
@@ -183,8 +205,6 @@ public:
 
     virtual std::string toString();
 
-    virtual ExpressionType getType();
-
 /*
  * Method: getName
  * Usage: string name = ((IdentifierExp *) exp)->getName();
@@ -195,9 +215,20 @@ public:
 
     std::string getName();
 
+/*
+ * Method: getSlot
+ * Usage: int slot = ((IdentifierExp *) exp)->getSlot();
+ * -----------------------------------------------------
+ * Returns the variable slot of the identifier and can be applied only
+ * to an object known to be an IdentifierExp.
+ */
+
+    int getSlot();
+
 private:
 
     std::string name;
+    int slot;
 
 };
 
@@ -236,11 +267,10 @@ public:
 
     virtual std::string toString();
 
-    virtual ExpressionType getType();
-
 /*
- * Methods: getOp, getLHS, getRHS
+ * Methods: getOp, getOpType, getLHS, getRHS
  * Usage: string op = ((CompoundExp *) exp)->getOp();
+ *        OperatorType opType = ((CompoundExp *) exp)->getOpType();
  *        Expression *lhs = ((CompoundExp *) exp)->getLHS();
  *        Expression *rhs = ((CompoundExp *) exp)->getRHS();
  * ---------------------------------------------------------
@@ -250,15 +280,157 @@ public:
 
     std::string getOp();
 
+    OperatorType getOpType();
+
     Expression *getLHS();
 
     Expression *getRHS();
 
+/*
+ * Method: setOperands
+ * Usage: ((CompoundExp *) exp)->setOperands(lhs, rhs);
+ * ----------------------------------------------------
+ * Replaces both subexpressions without freeing the old ones, which
+ * remain the responsibility of the caller.  Used by rewriting passes
+ * that move subtrees from one node to another.
+ */
+
+    void setOperands(Expression *lhs, Expression *rhs);
+
 private:
 
     std::string op;
+    OperatorType opType;
     Expression *lhs, *rhs;
 
 };
 
+/*
+ * Type: PostfixCode
+ * -----------------
+ * This enumerated type defines the operations of a PostfixExp program.
+ * PF_CONST and PF_VAR push a constant or the value of a variable slot,
+ * the arithmetic operations pop two values and push the result, and
+ * PF_ASSIGN stores the value on top of the stack into a slot without
+ * popping it.  PF_ERROR raises one of the errors that the tree
+ * evaluator reports for an illegal assignment.
+ *
+ * When the right operand of an arithmetic operation is a constant or a
+ * variable, the push is folded into the operation: the _CONST and _VAR
+ * forms take the right operand from the instruction and pop only the
+ * left one.  Each group lists the operators in the order + - * /.
+ */
+
+enum PostfixCode {
+    PF_CONST, PF_VAR,
+    PF_ADD, PF_SUB, PF_MUL, PF_DIV,
+    PF_ADD_CONST, PF_SUB_CONST, PF_MUL_CONST, PF_DIV_CONST,
+    PF_ADD_VAR, PF_SUB_VAR, PF_MUL_VAR, PF_DIV_VAR,
+    PF_ASSIGN, PF_ERROR
+};
+
+/*
+ * Constant: POSTFIX_ERRORS
+ * ------------------------
+ * The messages raised by PF_ERROR, indexed by its operand.
+ */
+
+extern const char *const POSTFIX_ERRORS[];
+
+/*
+ * Type: PostfixInstr
+ * ------------------
+ * One operation of a PostfixExp program together with its operand,
+ * which is the constant, the variable slot or the error number.
+ */
+
+struct PostfixInstr {
+    PostfixCode code;
+    int operand;
+};
+
+/*
+ * Class: PostfixExp
+ * -----------------
+ * This subclass represents an expression that has been flattened from
+ * a tree into a contiguous postfix (reverse Polish) array.  It is
+ * evaluated by a small stack machine, which avoids the recursion and
+ * the pointer chasing of the tree form, and produces exactly the same
+ * values, messages and errors as evaluating the original tree.
+ * A PostfixExp and its array always live in an Arena.
+ */
+
+class PostfixExp : public Expression {
+
+public:
+
+/*
+ * Constructor: PostfixExp
+ * Usage: Expression *exp = new (arena) PostfixExp(tree, arena);
+ * -------------------------------------------------------------
+ * The constructor flattens the specified expression tree into postfix
+ * form stored in the arena.  The tree is not modified; the caller
+ * still owns it.
+ */
+
+    PostfixExp(Expression *tree, Arena &arena);
+
+/*
+ * Constructor: PostfixExp
+ * Usage: Expression *exp = new (arena) PostfixExp(code, length, depth);
+ * ---------------------------------------------------------------------
+ * Wraps a postfix program that has already been built, for example
+ * one restored from a compiled-program cache.  The array is not copied
+ * and must live in the same arena as the expression.
+ */
+
+    PostfixExp(const PostfixInstr *code, int length, int depth);
+
+/*
+ * Prototypes for the virtual methods
+ * ----------------------------------
+ * These methods have the same prototypes as those in the Expression
+ * base class and don't require additional documentation.  The
+ * toString method rebuilds the parenthesized form of the tree.
+ */
+
+    virtual int eval(EvalState &state);
+
+    virtual std::string toString();
+
+/*
+ * Methods: getCode, getLength, getDepth
+ * Usage: const PostfixInstr *code = ((PostfixExp *) exp)->getCode();
+ *        int length = ((PostfixExp *) exp)->getLength();
+ *        int depth = ((PostfixExp *) exp)->getDepth();
+ * -------------------------------------------------------------------
+ * These methods return the postfix program, its number of
+ * instructions and the largest number of values it keeps on the
+ * evaluation stack.
+ */
+
+    const PostfixInstr *getCode();
+
+    int getLength();
+
+    int getDepth();
+
+private:
+
+    const PostfixInstr *code;
+    int length;
+    int depth;
+
+};
+
+/*
+ * Function: compileExp
+ * Usage: Expression *exp = compileExp(tree, arena);
+ * -------------------------------------------------
+ * Returns the postfix form of the specified expression tree, allocated
+ * in the arena, and frees the tree.
+ */
+
+Expression *compileExp(Expression *tree, Arena &arena);
+
 #endif
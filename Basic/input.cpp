@@ -0,0 +1,129 @@
+/*
+ * File: input.cpp
+ * ---------------
+ * This file implements the input.h interface.
+ */
+
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "input.hpp"
+#include "output.hpp"
+
+int Input::descriptor = STDIN_FILENO;
+std::vector<char> Input::buffer(Input::CAPACITY);
+size_t Input::start = 0;
+size_t Input::end = 0;
+bool Input::exhausted = false;
+
+/*
+ * Implementation notes: readLine
+ * ------------------------------
+ * The unread bytes are kept in buffer[start, end).  When they hold no
+ * complete line, fill moves them to the front and reads more behind
+ * them, doubling the buffer for lines longer than it.  Pending output,
+ * such as the INPUT prompt, is flushed before every read, because that
+ * is the only point where the interpreter may wait for the user; lines
+ * already buffered are answered without a system call either way.
+ */
+
+bool Input::readLine(std::string_view &line) {
+    size_t scanned = 0;
+    while (true) {
+        const char *newline = (const char *) std::memchr(buffer.data() + start + scanned, '\n',
+                                                         end - start - scanned);
+        if (newline != nullptr) {
+            size_t stop = newline - buffer.data();
+            line = std::string_view(buffer.data() + start, stop - start);
+            start = stop + 1;
+            return true;
+        }
+        scanned = end - start;
+        if (!fill()) break;
+    }
+    if (start == end) return false;
+    line = std::string_view(buffer.data() + start, end - start);
+    start = end;
+    return true;
+}
+
+bool Input::readLine(std::string &line) {
+    std::string_view view;
+    if (!readLine(view)) return false;
+    line.assign(view.data(), view.length());
+    return true;
+}
+
+bool Input::peekLine(std::string_view &line) {
+    const char *newline = (const char *) std::memchr(buffer.data() + start, '\n', end - start);
+    if (newline != nullptr) {
+        line = std::string_view(buffer.data() + start, newline - (buffer.data() + start));
+        return true;
+    }
+    if (!exhausted || start == end) return false;
+    line = std::string_view(buffer.data() + start, end - start);
+    return true;
+}
+
+bool Input::open(const std::string &filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    descriptor = fd;
+    start = end = 0;
+    exhausted = false;
+    return true;
+}
+
+bool Input::fill() {
+    if (exhausted) return false;
+    if (start > 0) {
+        std::memmove(buffer.data(), buffer.data() + start, end - start);
+        end -= start;
+        start = 0;
+    }
+    if (end == buffer.size()) buffer.resize(2 * buffer.size());
+    Output::flush();
+    while (true) {
+        ssize_t n = ::read(descriptor, buffer.data() + end, buffer.size() - end);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            exhausted = true;
+            return false;
+        }
+        end += n;
+        return true;
+    }
+}
+
+/*
+ * Implementation notes: parseInteger
+ * ----------------------------------
+ * White space is whatever the token scanner skips.  Any character that
+ * could make the scanner see something other than an optional '-' token
+ * followed by one NUMBER token, such as '.', 'e' or a second sign, ends
+ * the fast path, so the caller's full check decides those lines.
+ */
+
+bool Input::parseInteger(std::string_view line, int &value) {
+    const char *cp = line.data();
+    const char *limit = cp + line.length();
+    while (cp < limit && isspace((unsigned char) *cp)) cp++;
+    bool negative = false;
+    if (cp < limit && *cp == '-') {
+        negative = true;
+        cp++;
+        while (cp < limit && isspace((unsigned char) *cp)) cp++;
+    }
+    if (cp == limit || !isdigit((unsigned char) *cp)) return false;
+    int magnitude;
+    std::from_chars_result result = std::from_chars(cp, limit, magnitude);
+    if (result.ec != std::errc()) return false;
+    for (cp = result.ptr; cp < limit; cp++) {
+        if (!isspace((unsigned char) *cp)) return false;
+    }
+    value = negative ? -magnitude : magnitude;
+    return true;
+}
@@ -0,0 +1,94 @@
+/*
+ * File: input.h
+ * -------------
+ * This interface exports the Input class, the buffered channel through
+ * which the interpreter reads standard input.
+ */
+
+#ifndef _input_h
+#define _input_h
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Class: Input
+ * ------------
+ * Both the command loop and the INPUT statement read lines from one
+ * process-wide buffer filled from file descriptor 0 with large reads,
+ * so a piped file is consumed in a few system calls no matter how the
+ * reads interleave.  Buffered output is flushed before each read of
+ * the descriptor, so a prompt is always visible before the interpreter
+ * waits.  Nothing else may read standard input, since bytes
+ * already in this buffer are invisible to std::cin.
+ */
+
+class Input {
+
+public:
+
+/*
+ * Method: readLine
+ * Usage: if (Input::readLine(line)) ...
+ * -------------------------------------
+ * Reads the next line, without its newline character, and returns
+ * true; returns false once the input is exhausted.  A final line with
+ * no newline is still returned, exactly as std::getline does.  The
+ * string_view form points into the input buffer and stays valid only
+ * until the next call.
+ */
+
+    static bool readLine(std::string_view &line);
+
+    static bool readLine(std::string &line);
+
+/*
+ * Method: peekLine
+ * Usage: if (Input::peekLine(line)) ...
+ * -------------------------------------
+ * Returns the next line without consuming it, but only if it is
+ * already in the buffer; never reads from the descriptor.  While only
+ * buffered lines are read, views returned earlier stay valid.
+ */
+
+    static bool peekLine(std::string_view &line);
+
+/*
+ * Method: open
+ * Usage: if (Input::open(filename)) ...
+ * -------------------------------------
+ * Makes the named file the source of all further input in place of
+ * standard input.  Returns false if the file cannot be opened.
+ */
+
+    static bool open(const std::string &filename);
+
+/*
+ * Method: parseInteger
+ * Usage: if (Input::parseInteger(line, value)) ...
+ * ------------------------------------------------
+ * Recognizes the common shape of an answer to INPUT, an optionally
+ * negated run of decimal digits surrounded by white space, and stores
+ * its value.  Returns false for anything else, including values out of
+ * the range of int, leaving the caller to tokenize the line in full.
+ */
+
+    static bool parseInteger(std::string_view line, int &value);
+
+private:
+
+    static const size_t CAPACITY = 1 << 16;
+
+    static int descriptor;
+    static std::vector<char> buffer;
+    static size_t start;
+    static size_t end;
+    static bool exhausted;
+
+    static bool fill();
+
+};
+
+#endif
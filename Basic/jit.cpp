@@ -0,0 +1,490 @@
+/*
+ * File: jit.cpp
+ * -------------
+ * This file implements the x86-64 translation of lowered programs.
+ */
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <initializer_list>
+#include <vector>
+#include "jit.hpp"
+#include "threaded.hpp"
+#include "output.hpp"
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__))
+#define JIT_AVAILABLE 1
+#include <sys/mman.h>
+#else
+#define JIT_AVAILABLE 0
+#endif
+
+#if JIT_AVAILABLE
+
+/*
+ * Type: JitContext
+ * ----------------
+ * The state shared between generated code and the helpers it calls.
+ * Generated code tests the failed flag, which must stay the first
+ * field, after every helper that can throw.  The exception itself is
+ * kept here and rethrown once the generated code has returned, since
+ * it cannot be unwound through frames that have no unwind tables.
+ */
+
+struct JitContext {
+    bool failed;
+    EvalState *state;
+    Program *program;
+    LoweredProgram *lowered;
+    std::exception_ptr exception;
+};
+
+/*
+ * Implementation notes: helpers
+ * -----------------------------
+ * These functions are called from generated code with the context in
+ * the first argument register.  The messages match those printed by
+ * the expression classes and RunStatement.
+ */
+
+static int jitUndefinedVariable(JitContext *) {
+    Output::writeLine("VARIABLE NOT DEFINED");
+    return 114514;
+}
+
+static int jitDivideByZero(JitContext *) {
+    Output::writeLine("DIVIDE BY ZERO");
+    return 114514;
+}
+
+static void jitPrint(JitContext *, int value) {
+    if (value != 114514) {
+        Output::writeLine(value);
+    }
+}
+
+static void jitLetIllegal(JitContext *) {
+    Output::writeLine("SYNTAX ERROR");
+}
+
+static void jitLineError(JitContext *) {
+    Output::writeLine("LINE NUMBER ERROR");
+}
+
+static void jitError(JitContext *ctx, int index) {
+    try {
+        error(POSTFIX_ERRORS[index]);
+    } catch (...) {
+        ctx->exception = std::current_exception();
+        ctx->failed = true;
+    }
+}
+
+static int jitEval(JitContext *ctx, int index) {
+    try {
+        return ctx->lowered->exprs[index]->eval(*ctx->state);
+    } catch (...) {
+        ctx->exception = std::current_exception();
+        ctx->failed = true;
+        return 0;
+    }
+}
+
+static int jitCall(JitContext *ctx, int index) {
+    try {
+        return ctx->lowered->calls[index]->execute(*ctx->state, *ctx->program) == STOP;
+    } catch (...) {
+        ctx->exception = std::current_exception();
+        ctx->failed = true;
+        return 1;
+    }
+}
+
+/*
+ * Class: JitCompiler
+ * ------------------
+ * Translates a lowered program into machine code.  Generated code has
+ * the signature
+ *
+ *    void run(JitContext *ctx, int *values, uint64_t *defined);
+ *
+ * and keeps ctx in r13, values in rbx and defined in r12.  The top of
+ * the expression stack lives in eax and the values below it are pushed
+ * on the machine stack.  The compiler tracks the stack depth at every
+ * operation, so it knows statically whether a helper call needs padding
+ * to keep the machine stack 16-byte aligned.  Jumps only ever target
+ * the start of a statement, where the expression stack is empty.
+ */
+
+class JitCompiler {
+
+public:
+
+    std::vector<uint8_t> code;
+
+    bool compile(const LoweredProgram &lowered);
+
+private:
+
+    int depth;                                   /* Expression stack depth  */
+    std::vector<int> offsets;                    /* Code offset of each op  */
+    std::vector<std::pair<int, int>> jumps;      /* (site, op index) pairs  */
+    std::vector<int> exits;                      /* Sites that jump to exit */
+
+    void emit(std::initializer_list<int> bytes);
+    void emit32(int32_t value);
+    void emit64(uint64_t value);
+    int emitJump(std::initializer_list<int> opcode);
+    void patch(int site, int target);
+
+    void pushTop();
+    void call(const void *helper, int extra);
+    void exitIfFailed();
+    void loadVariable(int slot);
+    void loadOperand(int slot);
+    void divide();
+    void compileOp(const LoweredOp &op);
+
+};
+
+void JitCompiler::emit(std::initializer_list<int> bytes) {
+    for (int b : bytes) code.push_back((uint8_t) b);
+}
+
+void JitCompiler::emit32(int32_t value) {
+    uint8_t bytes[4];
+    std::memcpy(bytes, &value, 4);
+    code.insert(code.end(), bytes, bytes + 4);
+}
+
+void JitCompiler::emit64(uint64_t value) {
+    uint8_t bytes[8];
+    std::memcpy(bytes, &value, 8);
+    code.insert(code.end(), bytes, bytes + 8);
+}
+
+int JitCompiler::emitJump(std::initializer_list<int> opcode) {
+    emit(opcode);
+    emit32(0);
+    return code.size() - 4;
+}
+
+void JitCompiler::patch(int site, int target) {
+    int32_t rel = target - (site + 4);
+    std::memcpy(&code[site], &rel, 4);
+}
+
+/*
+ * Implementation notes: pushTop, call
+ * -----------------------------------
+ * pushTop makes room for a new value by spilling eax, if the stack is
+ * not empty.  call loads ctx into rdi and calls the helper through r11;
+ * extra counts values pushed on top of the expression stack, and one
+ * padding slot is added when the total is odd.
+ */
+
+void JitCompiler::pushTop() {
+    if (depth > 0) emit({0x50});                 /* push rax          */
+    depth++;
+}
+
+void JitCompiler::call(const void *helper, int extra) {
+    bool pad = ((depth > 0 ? depth - 1 : 0) + extra) & 1;
+    if (pad) emit({0x48, 0x83, 0xEC, 0x08});     /* sub rsp, 8        */
+    emit({0x4C, 0x89, 0xEF});                    /* mov rdi, r13      */
+    emit({0x49, 0xBB});                          /* mov r11, helper   */
+    emit64((uint64_t) (uintptr_t) helper);
+    emit({0x41, 0xFF, 0xD3});                    /* call r11          */
+    if (pad) emit({0x48, 0x83, 0xC4, 0x08});     /* add rsp, 8        */
+}
+
+void JitCompiler::exitIfFailed() {
+    emit({0x41, 0x80, 0x7D, 0x00, 0x00});        /* cmp [r13], 0      */
+    exits.push_back(emitJump({0x0F, 0x85}));     /* jnz exit          */
+}
+
+/*
+ * Implementation notes: loadVariable, loadOperand
+ * -----------------------------------------------
+ * Both test the definition bit of the slot and take the helper path
+ * when it is clear.  loadVariable leaves the value in eax; loadOperand
+ * leaves it in ecx and preserves eax around the helper call.
+ */
+
+void JitCompiler::loadVariable(int slot) {
+    emit({0x49, 0x0F, 0xBA, 0xA4, 0x24});        /* bt [r12+d], bit   */
+    emit32((slot >> 6) * 8);
+    emit({slot & 63});
+    int defined = emitJump({0x0F, 0x82});        /* jc defined        */
+    call((const void *) jitUndefinedVariable, 0);
+    int done = emitJump({0xE9});                 /* jmp done          */
+    patch(defined, code.size());
+    emit({0x8B, 0x83});                          /* mov eax, [rbx+d]  */
+    emit32(slot * 4);
+    patch(done, code.size());
+}
+
+void JitCompiler::loadOperand(int slot) {
+    emit({0x49, 0x0F, 0xBA, 0xA4, 0x24});        /* bt [r12+d], bit   */
+    emit32((slot >> 6) * 8);
+    emit({slot & 63});
+    int defined = emitJump({0x0F, 0x82});        /* jc defined        */
+    emit({0x50});                                /* push rax          */
+    call((const void *) jitUndefinedVariable, 1);
+    emit({0x89, 0xC1});                          /* mov ecx, eax      */
+    emit({0x58});                                /* pop rax           */
+    int done = emitJump({0xE9});                 /* jmp done          */
+    patch(defined, code.size());
+    emit({0x8B, 0x8B});                          /* mov ecx, [rbx+d]  */
+    emit32(slot * 4);
+    patch(done, code.size());
+}
+
+void JitCompiler::divide() {
+    emit({0x85, 0xC9});                          /* test ecx, ecx     */
+    int nonzero = emitJump({0x0F, 0x85});        /* jnz nonzero       */
+    call((const void *) jitDivideByZero, 0);
+    int done = emitJump({0xE9});                 /* jmp done          */
+    patch(nonzero, code.size());
+    emit({0x99});                                /* cdq               */
+    emit({0xF7, 0xF9});                          /* idiv ecx          */
+    patch(done, code.size());
+}
+
+void JitCompiler::compileOp(const LoweredOp &op) {
+    switch (op.code) {
+        case PF_CONST:
+            pushTop();
+            emit({0xB8});                        /* mov eax, imm      */
+            emit32(op.operand);
+            break;
+        case PF_VAR:
+            pushTop();
+            loadVariable(op.operand);
+            break;
+        case PF_ADD:
+            emit({0x89, 0xC1, 0x58});            /* mov ecx, eax; pop */
+            emit({0x01, 0xC8});                  /* add eax, ecx      */
+            depth--;
+            break;
+        case PF_SUB:
+            emit({0x89, 0xC1, 0x58});
+            emit({0x29, 0xC8});                  /* sub eax, ecx      */
+            depth--;
+            break;
+        case PF_MUL:
+            emit({0x59});                        /* pop rcx           */
+            emit({0x0F, 0xAF, 0xC1});            /* imul eax, ecx     */
+            depth--;
+            break;
+        case PF_DIV:
+            emit({0x89, 0xC1, 0x58});
+            depth--;
+            divide();
+            break;
+        case PF_ADD_CONST:
+            emit({0x05});                        /* add eax, imm      */
+            emit32(op.operand);
+            break;
+        case PF_SUB_CONST:
+            emit({0x2D});                        /* sub eax, imm      */
+            emit32(op.operand);
+            break;
+        case PF_MUL_CONST:
+            emit({0x69, 0xC0});                  /* imul eax, eax, imm */
+            emit32(op.operand);
+            break;
+        case PF_DIV_CONST:
+            emit({0xB9});                        /* mov ecx, imm      */
+            emit32(op.operand);
+            divide();
+            break;
+        case PF_ADD_VAR:
+            loadOperand(op.operand);
+            emit({0x01, 0xC8});
+            break;
+        case PF_SUB_VAR:
+            loadOperand(op.operand);
+            emit({0x29, 0xC8});
+            break;
+        case PF_MUL_VAR:
+            loadOperand(op.operand);
+            emit({0x0F, 0xAF, 0xC1});
+            break;
+        case PF_DIV_VAR:
+            loadOperand(op.operand);
+            divide();
+            break;
+        case PF_ASSIGN:
+        case L_LET:
+            if (op.operand >= 0) {
+                emit({0x89, 0x83});              /* mov [rbx+d], eax  */
+                emit32(op.operand * 4);
+                emit({0x49, 0x0F, 0xBA, 0xAC, 0x24});  /* bts [r12+d], bit */
+                emit32((op.operand >> 6) * 8);
+                emit({op.operand & 63});
+            }
+            if (op.code == L_LET) {
+                depth--;
+            } else if (op.operand < 0) {
+                emit({0x59});                    /* pop rcx           */
+                depth--;
+            }
+            break;
+        case PF_ERROR:
+            emit({0xBE});                        /* mov esi, imm      */
+            emit32(op.operand);
+            call((const void *) jitError, 0);
+            exits.push_back(emitJump({0xE9}));   /* jmp exit          */
+            break;
+        case L_EVAL:
+            pushTop();
+            emit({0xBE});
+            emit32(op.operand);
+            call((const void *) jitEval, 0);
+            exitIfFailed();
+            break;
+        case L_LET_ILLEGAL:
+            call((const void *) jitLetIllegal, 0);
+            break;
+        case L_PRINT:
+            emit({0x89, 0xC6});                  /* mov esi, eax      */
+            depth--;
+            call((const void *) jitPrint, 0);
+            break;
+        case L_GOTO:
+            jumps.emplace_back(emitJump({0xE9}), op.operand);
+            break;
+        case L_IF_EQ:
+        case L_IF_LT:
+        case L_IF_GT: {
+            emit({0x89, 0xC1, 0x58});
+            emit({0x39, 0xC8});                  /* cmp eax, ecx      */
+            depth -= 2;
+            int cc = op.code == L_IF_EQ ? 0x84 : op.code == L_IF_LT ? 0x8C : 0x8F;
+            jumps.emplace_back(emitJump({0x0F, cc}), op.operand);
+            break;
+        }
+        case L_LINE_ERROR:
+            call((const void *) jitLineError, 0);
+            break;
+        case L_CALL:
+            emit({0xBE});
+            emit32(op.operand);
+            call((const void *) jitCall, 0);
+            emit({0x85, 0xC0});                  /* test eax, eax     */
+            exits.push_back(emitJump({0x0F, 0x85}));
+            break;
+        case L_HALT:
+            exits.push_back(emitJump({0xE9}));
+            break;
+    }
+}
+
+/*
+ * Implementation notes: compile
+ * -----------------------------
+ * Every statement must leave the expression stack empty, since the
+ * depth tracked here is carried from one statement into the next and
+ * jumps assume an empty stack.  An operation whose depth bookkeeping
+ * disagrees with the postfix compiler would misalign every later
+ * statement, so the depth is checked at each statement boundary and
+ * the translation is rejected if it is not zero.
+ */
+
+static bool endsStatement(int code) {
+    switch (code) {
+        case L_LET:
+        case L_LET_ILLEGAL:
+        case L_PRINT:
+        case L_GOTO:
+        case L_IF_EQ:
+        case L_IF_LT:
+        case L_IF_GT:
+        case L_CALL:
+        case L_HALT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool JitCompiler::compile(const LoweredProgram &lowered) {
+    code.clear();
+    jumps.clear();
+    exits.clear();
+    offsets.assign(lowered.ops.size(), 0);
+    depth = 0;
+    emit({0x55});                                /* push rbp          */
+    emit({0x48, 0x89, 0xE5});                    /* mov rbp, rsp      */
+    emit({0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56}); /* push rbx, r12-r14 */
+    emit({0x49, 0x89, 0xFD});                    /* mov r13, rdi      */
+    emit({0x48, 0x89, 0xF3});                    /* mov rbx, rsi      */
+    emit({0x49, 0x89, 0xD4});                    /* mov r12, rdx      */
+    for (size_t i = 0; i < lowered.ops.size(); i++) {
+        offsets[i] = code.size();
+        compileOp(lowered.ops[i]);
+        if (endsStatement(lowered.ops[i].code) && depth != 0) {
+            assert(!"JIT expression stack out of balance");
+            return false;
+        }
+    }
+    int exit = code.size();
+    emit({0x48, 0x8D, 0x65, 0xE0});              /* lea rsp, [rbp-32] */
+    emit({0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0x5D}); /* pop r14-r12, rbx, rbp */
+    emit({0xC3});                                /* ret               */
+    for (const std::pair<int, int> &jump : jumps) {
+        patch(jump.first, offsets[jump.second]);
+    }
+    for (int site : exits) {
+        patch(site, exit);
+    }
+    return true;
+}
+
+#endif
+
+/*
+ * Implementation notes: runJit
+ * ----------------------------
+ * The code is written into anonymous pages that are made executable
+ * only after the translation is complete, and unmapped before any
+ * exception saved by a helper is rethrown.
+ */
+
+void runJit(EvalState &state, Program &program) {
+#if JIT_AVAILABLE
+    LoweredProgram lowered;
+    lowerProgram(program, lowered);
+    JitCompiler compiler;
+    if (!compiler.compile(lowered)) {
+        runThreaded(state, program);
+        return;
+    }
+    size_t size = compiler.code.size();
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        runThreaded(state, program);
+        return;
+    }
+    std::memcpy(memory, compiler.code.data(), size);
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        runThreaded(state, program);
+        return;
+    }
+    JitContext ctx = {false, &state, &program, &lowered, nullptr};
+    int *values;
+    uint64_t *defined;
+    state.getStorage(values, defined);
+    ((void (*)(JitContext *, int *, uint64_t *)) memory)(&ctx, values, defined);
+    munmap(memory, size);
+    if (ctx.exception) {
+        std::rethrow_exception(ctx.exception);
+    }
+#else
+    runThreaded(state, program);
+#endif
+}
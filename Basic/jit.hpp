@@ -0,0 +1,30 @@
+/*
+ * File: jit.h
+ * -----------
+ * This interface exports the native execution engine, which translates
+ * a lowered program into x86-64 machine code before running it.
+ */
+
+#ifndef _jit_h
+#define _jit_h
+
+#include "evalstate.hpp"
+#include "program.hpp"
+
+/*
+ * Function: runJit
+ * Usage: runJit(state, program);
+ * ------------------------------
+ * Translates the program into x86-64 code in freshly mapped executable
+ * pages and runs it.  Arithmetic, LET, GOTO and IF run natively with the
+ * top of the expression stack kept in a register; PRINT, INPUT and the
+ * error messages call back into C++.  The output is identical to
+ * RunStatement with the TREE_WALKER engine.  On other targets, if
+ * executable memory cannot be mapped or if the translation fails its
+ * own consistency check, the program runs on the threaded engine
+ * instead.
+ */
+
+void runJit(EvalState &state, Program &program);
+
+#endif
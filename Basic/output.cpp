@@ -0,0 +1,65 @@
+/*
+ * File: output.cpp
+ * ----------------
+ * This file implements the output.h interface.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include "output.hpp"
+#include "profiler.hpp"
+
+char Output::buffer[Output::CAPACITY];
+size_t Output::length = 0;
+FlushPolicy Output::policy = isatty(STDOUT_FILENO) ? FLUSH_LINES : FLUSH_FULL;
+
+/*
+ * Implementation notes: write
+ * ---------------------------
+ * Text that does not fit in the free space flushes the buffer first;
+ * text longer than the whole buffer is written straight through.
+ */
+
+void Output::write(std::string_view text) {
+    if (text.length() > CAPACITY - length) {
+        flush();
+        if (text.length() > CAPACITY) {
+            size_t done = 0;
+            while (done < text.length()) {
+                ssize_t n = ::write(STDOUT_FILENO, text.data() + done, text.length() - done);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return;
+                done += n;
+            }
+            return;
+        }
+    }
+    std::memcpy(buffer + length, text.data(), text.length());
+    length += text.length();
+}
+
+void Output::writeLine(std::string_view text) {
+    write(text);
+    endLine();
+}
+
+void Output::flush() {
+    SamplePhaseScope phase(PHASE_OUTPUT);
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = ::write(STDOUT_FILENO, buffer + done, length - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    length = 0;
+}
+
+void Output::setPolicy(FlushPolicy policy) {
+    Output::policy = policy;
+}
+
+FlushPolicy Output::getPolicy() {
+    return policy;
+}
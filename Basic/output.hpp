@@ -0,0 +1,111 @@
+/*
+ * File: output.h
+ * --------------
+ * This interface exports the Output class, the buffered channel through
+ * which the interpreter writes everything it prints.
+ */
+
+#ifndef _output_h
+#define _output_h
+
+#include <charconv>
+#include <cstddef>
+#include <string_view>
+
+/*
+ * Type: FlushPolicy
+ * -----------------
+ * This enumerated type selects when buffered output reaches standard
+ * output: after every line (FLUSH_LINES), which suits a terminal, or
+ * only when the buffer fills or flush is called (FLUSH_FULL), which
+ * suits output redirected to a file or pipe.
+ */
+
+enum FlushPolicy {
+    FLUSH_LINES, FLUSH_FULL
+};
+
+/*
+ * Class: Output
+ * -------------
+ * All output of the interpreter goes through one process-wide buffer
+ * that is written to file descriptor 1 with write.  Integers are
+ * formatted in place with std::to_chars.  Besides the policy, the
+ * buffer is flushed explicitly before a prompt waits for input, before
+ * the process exits and when an error ends the session, so output is
+ * never reordered against prompts or lost.
+ */
+
+class Output {
+
+public:
+
+/*
+ * Methods: write, writeLine
+ * Usage: Output::write(" ? ");
+ *        Output::writeLine("SYNTAX ERROR");
+ *        Output::writeLine(value);
+ * --------------------------------------
+ * Append text or a decimal integer to the buffer; writeLine also ends
+ * the line.
+ */
+
+    static void write(std::string_view text);
+
+    static void write(int value);
+
+    static void writeLine(std::string_view text);
+
+    static void writeLine(int value);
+
+/*
+ * Method: flush
+ * Usage: Output::flush();
+ * -----------------------
+ * Writes everything buffered so far to standard output.  Only calls
+ * that are safe in a signal handler are used.
+ */
+
+    static void flush();
+
+/*
+ * Methods: setPolicy, getPolicy
+ * Usage: Output::setPolicy(FLUSH_FULL);
+ * -------------------------------------
+ * Sets and returns the flush policy.  The default is FLUSH_LINES when
+ * standard output is a terminal and FLUSH_FULL otherwise.
+ */
+
+    static void setPolicy(FlushPolicy policy);
+
+    static FlushPolicy getPolicy();
+
+private:
+
+    static const size_t CAPACITY = 1 << 16;
+
+    static char buffer[CAPACITY];
+    static size_t length;
+    static FlushPolicy policy;
+
+    static void endLine();
+
+};
+
+inline void Output::write(int value) {
+    if (CAPACITY - length < 16) flush();
+    length = std::to_chars(buffer + length, buffer + CAPACITY, value).ptr - buffer;
+}
+
+inline void Output::writeLine(int value) {
+    write(value);
+    endLine();
+}
+
+inline void Output::endLine() {
+    if (length == CAPACITY) flush();
+    buffer[length++] = '\n';
+    if (policy == FLUSH_LINES || length == CAPACITY) flush();
+}
+
+#endif
@@ -4,6 +4,8 @@
  * Implements the parser.h interface.
  */
 
+#include <climits>
+#include <vector>
 #include "parser.hpp"
 
 
@@ -11,72 +13,254 @@
  * Implementation notes: parseExp
  * ------------------------------
  * This code just reads an expression and then checks for extra tokens.
+ * The tree is then simplified and flattened into the postfix form used
+ * for evaluation.
  */
 
-Expression *parseExp(TokenScanner &scanner) {
+Expression *parseExp(TokenScanner &scanner, Arena &arena) {
     Expression *exp = readE(scanner);
     if (scanner.hasMoreTokens()) {
+        delete exp;
         error("parseExp: Found extra token: " + scanner.nextToken());
     }
-    return exp;
+    return compileExp(foldExp(exp), arena);
 }
 
 /*
- * Implementation notes: readE
- * Usage: exp = readE(scanner, prec);
- * ----------------------------------
- * This version of readE uses precedence to resolve the ambiguity in
- * the grammar.  At each recursive level, the parser reads operators and
- * subexpressions until it finds an operator whose precedence is greater
- * than the prevailing one.  When a higher-precedence operator is found,
- * readE calls itself recursively to read in that subexpression as a unit.
+ * Implementation notes: foldExp
+ * -----------------------------
+ * The pass works bottom-up and takes ownership of its argument: a node
+ * that is replaced is freed, after its surviving subtrees have been
+ * detached with setOperands.  Constant arithmetic wraps around like the
+ * evaluator does on every supported target; a division by zero and
+ * the overflowing INT_MIN / -1 are left for run time.  The left operand
+ * of an assignment is never touched, so an illegal target still raises
+ * the same error when the statement executes.
  */
 
-Expression *readE(TokenScanner &scanner, int prec) {
-    Expression *exp = readT(scanner);
-    std::string token;
+static bool foldConstant(OperatorType op, int lhs, int rhs, int &result) {
+    switch (op) {
+        case OP_ADD:
+            result = (int) ((unsigned) lhs + (unsigned) rhs);
+            return true;
+        case OP_SUB:
+            result = (int) ((unsigned) lhs - (unsigned) rhs);
+            return true;
+        case OP_MUL:
+            result = (int) ((unsigned) lhs * (unsigned) rhs);
+            return true;
+        case OP_DIV:
+            if (rhs == 0 || (lhs == INT_MIN && rhs == -1)) return false;
+            result = lhs / rhs;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool isConstant(Expression *exp, int value) {
+    return exp->getType() == CONSTANT && ((ConstantExp *) exp)->getValue() == value;
+}
+
+static Expression *keepOperand(CompoundExp *exp, Expression *kept) {
+    Expression *lhs = exp->getLHS() == kept ? nullptr : exp->getLHS();
+    Expression *rhs = exp->getRHS() == kept ? nullptr : exp->getRHS();
+    exp->setOperands(lhs, rhs);
+    delete exp;
+    return kept;
+}
+
+static Expression *foldNode(CompoundExp *node) {
+    OperatorType op = node->getOpType();
+    Expression *lhs = node->getLHS();
+    Expression *rhs = node->getRHS();
+    if (op == OP_ASSIGN) return node;
+    int value;
+    if (lhs->getType() == CONSTANT && rhs->getType() == CONSTANT
+        && foldConstant(op, ((ConstantExp *) lhs)->getValue(), ((ConstantExp *) rhs)->getValue(), value)) {
+        delete node;
+        return new ConstantExp(value);
+    }
+    if ((op == OP_ADD || op == OP_SUB) && isConstant(rhs, 0)) return keepOperand(node, lhs);
+    if (op == OP_ADD && isConstant(lhs, 0)) return keepOperand(node, rhs);
+    if ((op == OP_MUL || op == OP_DIV) && isConstant(rhs, 1)) return keepOperand(node, lhs);
+    if (op == OP_MUL && isConstant(lhs, 1)) return keepOperand(node, rhs);
+    if ((op == OP_ADD || op == OP_SUB) && rhs->getType() == COMPOUND) {
+        CompoundExp *negation = (CompoundExp *) rhs;
+        if (negation->getOpType() == OP_SUB && isConstant(negation->getLHS(), 0)) {
+            Expression *operand = negation->getRHS();
+            Expression *result = new CompoundExp(op == OP_ADD ? "-" : "+", lhs, operand);
+            negation->setOperands(negation->getLHS(), nullptr);
+            node->setOperands(nullptr, negation);
+            delete node;
+            return result;
+        }
+    }
+    return node;
+}
+
+/*
+ * The traversal keeps its own stack so that deeply nested expressions
+ * cannot overflow the call stack.  Each entry records the parent and
+ * side that receive the folded node; an entry is folded by foldNode
+ * once both of its operands have been folded.
+ */
+
+struct FoldFrame {
+    CompoundExp *node;
+    CompoundExp *parent;
+    bool isLeft;
+    bool expanded;
+};
+
+Expression *foldExp(Expression *exp) {
+    if (exp->getType() != COMPOUND) return exp;
+    std::vector<FoldFrame> stack;
+    stack.push_back({(CompoundExp *) exp, nullptr, false, false});
     while (true) {
-        token = scanner.nextToken();
-        int newPrec = precedence(token);
-        if (newPrec <= prec) break;
-        Expression *rhs = readE(scanner, newPrec);
-        exp = new CompoundExp(token, exp, rhs);
+        FoldFrame frame = stack.back();
+        if (!frame.expanded) {
+            stack.back().expanded = true;
+            Expression *lhs = frame.node->getLHS();
+            Expression *rhs = frame.node->getRHS();
+            if (rhs->getType() == COMPOUND) {
+                stack.push_back({(CompoundExp *) rhs, frame.node, false, false});
+            }
+            if (frame.node->getOpType() != OP_ASSIGN && lhs->getType() == COMPOUND) {
+                stack.push_back({(CompoundExp *) lhs, frame.node, true, false});
+            }
+            continue;
+        }
+        stack.pop_back();
+        Expression *result = foldNode(frame.node);
+        if (frame.parent == nullptr) return result;
+        if (frame.isLeft) {
+            frame.parent->setOperands(result, frame.parent->getRHS());
+        } else {
+            frame.parent->setOperands(frame.parent->getLHS(), result);
+        }
     }
-    scanner.saveToken(token);
-    return exp;
 }
 
 /*
- * Implementation notes: readT
- * ---------------------------
- * This function scans a term, which is either an integer, an identifier,
- * or a parenthesized subexpression.
+ * Implementation notes: readE, readT
+ * ----------------------------------
+ * Both functions run the same iterative parser, which keeps the calls
+ * of the classic recursive-descent version as frames on an explicit
+ * stack, so the nesting depth of an expression is limited only by
+ * memory.  An EXP_FRAME is one readE call: it holds the tree built so
+ * far and the operator waiting for its right operand, which is parsed
+ * by a new EXP_FRAME at that operator's precedence.  PAREN_FRAME and
+ * NEGATE_FRAME finish a parenthesized term and a unary minus, whose
+ * operand is read at precedence 0.  Tokens are consumed in exactly the
+ * order of the recursive version, so the trees and the errors are the
+ * same.
  */
 
-Expression *readT(TokenScanner &scanner) {
-    std::string token = scanner.nextToken();
-    TokenType type = scanner.getTokenType(token);
-    if (type == WORD) return new IdentifierExp(token);
-    if (type == NUMBER) return new ConstantExp(stringToInteger(token));
-    if (token == "-") return new CompoundExp(token, new ConstantExp(0), readE(scanner));
-    if (token != "(") error("Illegal term in expression");
-    Expression *exp = readE(scanner);
-    if (scanner.nextToken() != ")") {
-        error("Unbalanced parentheses in expression");
+enum ParseFrameKind {
+    RETURN_FRAME, EXP_FRAME, PAREN_FRAME, NEGATE_FRAME
+};
+
+struct ParseFrame {
+    ParseFrameKind kind;
+    int prec;
+    Expression *exp;
+    char op;
+};
+
+static Expression *parseIteratively(TokenScanner &scanner, std::vector<ParseFrame> &stack) {
+    Expression *result = nullptr;
+    bool needTerm = true;
+    while (true) {
+        if (needTerm) {
+            Token token = scanner.next();
+            if (token.type == WORD) {
+                result = new IdentifierExp(std::string(token.text));
+            } else if (token.type == NUMBER) {
+                result = new ConstantExp(stringToInteger(std::string(token.text)));
+            } else if (token.text == "-") {
+                stack.push_back({NEGATE_FRAME, 0, nullptr, 0});
+                stack.push_back({EXP_FRAME, 0, nullptr, 0});
+                continue;
+            } else if (token.text == "(") {
+                stack.push_back({PAREN_FRAME, 0, nullptr, 0});
+                stack.push_back({EXP_FRAME, 0, nullptr, 0});
+                continue;
+            } else {
+                error("Illegal term in expression");
+            }
+            needTerm = false;
+        }
+        ParseFrame &frame = stack.back();
+        switch (frame.kind) {
+            case RETURN_FRAME:
+                stack.pop_back();
+                return result;
+            case PAREN_FRAME:
+                if (scanner.next().text != ")") {
+                    error("Unbalanced parentheses in expression");
+                }
+                stack.pop_back();
+                break;
+            case NEGATE_FRAME:
+                result = new CompoundExp("-", new ConstantExp(0), result);
+                stack.pop_back();
+                break;
+            case EXP_FRAME: {
+                if (frame.exp == nullptr) {
+                    frame.exp = result;
+                } else {
+                    frame.exp = new CompoundExp(std::string(1, frame.op), frame.exp, result);
+                }
+                Token token = scanner.next();
+                int newPrec = precedence(token.text);
+                if (newPrec <= frame.prec) {
+                    scanner.saveToken(token.text);
+                    result = frame.exp;
+                    stack.pop_back();
+                    break;
+                }
+                frame.op = token.text[0];
+                stack.push_back({EXP_FRAME, newPrec, nullptr, 0});
+                needTerm = true;
+                break;
+            }
+        }
     }
-    return exp;
+}
+
+Expression *readE(TokenScanner &scanner, int prec) {
+    std::vector<ParseFrame> stack;
+    stack.push_back({RETURN_FRAME, 0, nullptr, 0});
+    stack.push_back({EXP_FRAME, prec, nullptr, 0});
+    return parseIteratively(scanner, stack);
+}
+
+Expression *readT(TokenScanner &scanner) {
+    std::vector<ParseFrame> stack;
+    stack.push_back({RETURN_FRAME, 0, nullptr, 0});
+    return parseIteratively(scanner, stack);
 }
 
 /*
  * Implementation notes: precedence
  * --------------------------------
- * This function checks the token against each of the defined operators
- * and returns the appropriate precedence value.
+ * Every operator is a single character, so the precedence is read from
+ * a table indexed by that character.
  */
 
-int precedence(std::string token) {
-    if (token == "=") return 1;
-    if (token == "+" || token == "-") return 2;
-    if (token == "*" || token == "/") return 3;
-    return 0;
+static constexpr struct PrecedenceTable {
+    signed char value[256];
+    constexpr PrecedenceTable() : value() {
+        value['='] = 1;
+        value['+'] = 2;
+        value['-'] = 2;
+        value['*'] = 3;
+        value['/'] = 3;
+    }
+} PRECEDENCE;
+
+int precedence(std::string_view token) {
+    if (token.length() != 1) return 0;
+    return PRECEDENCE.value[(unsigned char) token[0]];
 }
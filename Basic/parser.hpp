@@ -18,14 +18,29 @@
 
 /*
  * Function: parseExp
- * Usage: Expression *exp = parseExp(scanner);
- * -------------------------------------------
+ * Usage: Expression *exp = parseExp(scanner, arena);
+ * --------------------------------------------------
  * Parses an expression by reading tokens from the scanner, which must
  * be provided by the client.  The scanner should be set to ignore
- * whitespace and to scan numbers.
+ * whitespace and to scan numbers.  The result is a PostfixExp that is
+ * allocated in the arena.
  */
 
-Expression *parseExp(TokenScanner &scanner);
+Expression *parseExp(TokenScanner &scanner, Arena &arena);
+
+/*
+ * Function: foldExp
+ * Usage: exp = foldExp(exp);
+ * --------------------------
+ * Simplifies a parsed expression tree and returns the result, which
+ * replaces the argument: constant subtrees are folded, and identities
+ * such as x * 1, x + 0, x / 1 and a - (0 - b) are rewritten.  Division
+ * by a constant zero and every subtree that reads a variable or makes
+ * an assignment are kept, so the messages printed at run time do not
+ * change.
+ */
+
+Expression *foldExp(Expression *exp);
 
 /*
  * Function: readE
@@ -56,6 +71,6 @@ Expression *readT(TokenScanner &scanner);
  * is not an operator, precedence returns 0.
  */
 
-int precedence(std::string token);
+int precedence(std::string_view token);
 
 #endif
@@ -0,0 +1,262 @@
+/*
+ * File: profiler.cpp
+ * ------------------
+ * This file implements the profiler.h interface.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <sys/time.h>
+#include "output.hpp"
+#include "profiler.hpp"
+
+bool Profiler::enabled = false;
+std::vector<Profiler::Counter> Profiler::current;
+std::map<int, Profiler::LineCounter> Profiler::lines;
+
+void Profiler::setEnabled(bool flag) {
+    enabled = flag;
+}
+
+bool Profiler::isEnabled() {
+    return enabled;
+}
+
+void Profiler::reset() {
+    lines.clear();
+}
+
+void Profiler::beginRun(int size) {
+    current.assign(size, Counter{0, 0, 0});
+}
+
+/*
+ * Implementation notes: endRun
+ * ----------------------------
+ * The source text is copied when a line is first seen and refreshed on
+ * every run, so the report shows the line as it was last executed.
+ */
+
+void Profiler::endRun(const std::vector<Instruction> &code) {
+    for (size_t pc = 0; pc < current.size(); pc++) {
+        const Counter &counter = current[pc];
+        if (counter.count == 0) continue;
+        LineCounter &line = lines[code[pc].lineNumber];
+        line.counter.count += counter.count;
+        line.counter.total += counter.total;
+        line.counter.eval += counter.eval;
+        line.source = *code[pc].source;
+    }
+    current.clear();
+}
+
+/*
+ * Implementation notes: report
+ * ----------------------------
+ * Times are printed in microseconds; the share column is the part of
+ * the total time of all lines spent on the row's line.
+ */
+
+void Profiler::report() {
+    if (lines.empty()) return;
+    std::vector<std::map<int, LineCounter>::const_iterator> rows;
+    uint64_t sum = 0;
+    for (auto it = lines.begin(); it != lines.end(); ++it) {
+        rows.push_back(it);
+        sum += it->second.counter.total;
+    }
+    std::stable_sort(rows.begin(), rows.end(), [](auto a, auto b) {
+        return a->second.counter.total > b->second.counter.total;
+    });
+    char row[96];
+    snprintf(row, sizeof(row), "%8s %12s %12s %12s %6s  %s", "LINE", "COUNT", "TIME(us)", "EVAL(us)", "SHARE",
+             "SOURCE");
+    Output::writeLine(row);
+    for (auto it : rows) {
+        const Counter &counter = it->second.counter;
+        snprintf(row, sizeof(row), "%8d %12llu %12.1f %12.1f %5.1f%%  ", it->first,
+                 (unsigned long long) counter.count, counter.total / 1000.0, counter.eval / 1000.0,
+                 sum == 0 ? 0.0 : 100.0 * counter.total / sum);
+        Output::write(row);
+        Output::writeLine(it->second.source);
+    }
+}
+
+bool Profiler::writeCsv(const std::string &filename) {
+    FILE *file = fopen(filename.c_str(), "w");
+    if (file == nullptr) return false;
+    fprintf(file, "line,count,total_ns,eval_ns,source\n");
+    for (const auto &entry : lines) {
+        const Counter &counter = entry.second.counter;
+        fprintf(file, "%d,%llu,%llu,%llu,\"", entry.first, (unsigned long long) counter.count,
+                (unsigned long long) counter.total, (unsigned long long) counter.eval);
+        for (char ch : entry.second.source) {
+            if (ch == '"') fputc('"', file);
+            fputc(ch, file);
+        }
+        fprintf(file, "\"\n");
+    }
+    return fclose(file) == 0;
+}
+
+/*
+ * Implementation notes: sample table
+ * ----------------------------------
+ * The signal handler may not allocate or lock, so samples go into an
+ * open-addressed table of fixed size whose slots are claimed and
+ * counted with atomic operations.  The key packs the line and the phase
+ * into one word that is never zero, zero marking a free slot.  The
+ * handler can run on a parsing worker as well as on the main thread,
+ * which is why the variables it reads are thread-local and the table
+ * is updated atomically.  A sample that finds no slot within a short
+ * probe sequence is counted as dropped.
+ */
+
+namespace {
+
+const int TABLE_BITS = 14;
+const int TABLE_SIZE = 1 << TABLE_BITS;
+const int MAX_PROBES = 64;
+
+struct SampleSlot {
+    std::atomic<uint64_t> key;
+    std::atomic<uint64_t> count;
+};
+
+SampleSlot table[TABLE_SIZE];
+std::atomic<uint64_t> dropped;
+
+const char *const PHASE_NAMES[] = {"other", "tokenize", "parse", "execute", "eval", "output"};
+const int PHASE_COUNT = sizeof(PHASE_NAMES) / sizeof(PHASE_NAMES[0]);
+
+uint64_t makeKey(int line, int phase) {
+    return (uint64_t(uint32_t(line)) << 32) | uint32_t(phase + 1);
+}
+
+}
+
+bool Sampler::running = false;
+thread_local volatile sig_atomic_t Sampler::line = Sampler::NO_LINE;
+thread_local volatile sig_atomic_t Sampler::phase = PHASE_OTHER;
+
+void Sampler::handleSignal(int sig) {
+    uint64_t key = makeKey(line, phase);
+    size_t index = (key * 0x9E3779B97F4A7C15ull) >> (64 - TABLE_BITS);
+    for (int probe = 0; probe < MAX_PROBES; probe++) {
+        SampleSlot &slot = table[index];
+        uint64_t current = slot.key.load(std::memory_order_relaxed);
+        if (current == 0 && slot.key.compare_exchange_strong(current, key, std::memory_order_relaxed)) {
+            current = key;
+        }
+        if (current == key) {
+            slot.count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        index = (index + 1) & (TABLE_SIZE - 1);
+    }
+    dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool Sampler::start(int hz) {
+    stop();
+    reset();
+    struct sigaction action = {};
+    action.sa_handler = handleSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, nullptr) != 0) return false;
+    long interval = std::max(1000000L / hz, 1L);
+    itimerval timer = {};
+    timer.it_interval.tv_sec = interval / 1000000;
+    timer.it_interval.tv_usec = interval % 1000000;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) return false;
+    running = true;
+    return true;
+}
+
+void Sampler::stop() {
+    if (!running) return;
+    itimerval timer = {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    running = false;
+}
+
+bool Sampler::isRunning() {
+    return running;
+}
+
+/*
+ * Implementation notes: reset
+ * ---------------------------
+ * The timer is held off while the table is cleared so that the handler
+ * never sees a half-cleared slot.
+ */
+
+void Sampler::reset() {
+    itimerval saved;
+    itimerval off = {};
+    setitimer(ITIMER_PROF, &off, &saved);
+    for (SampleSlot &slot : table) {
+        slot.key.store(0, std::memory_order_relaxed);
+        slot.count.store(0, std::memory_order_relaxed);
+    }
+    dropped.store(0, std::memory_order_relaxed);
+    setitimer(ITIMER_PROF, &saved, nullptr);
+}
+
+void Sampler::report() {
+    uint64_t counts[PHASE_COUNT] = {};
+    uint64_t sum = 0;
+    for (const SampleSlot &slot : table) {
+        uint64_t key = slot.key.load(std::memory_order_relaxed);
+        if (key == 0) continue;
+        uint64_t count = slot.count.load(std::memory_order_relaxed);
+        counts[uint32_t(key) - 1] += count;
+        sum += count;
+    }
+    if (sum == 0) return;
+    char row[64];
+    snprintf(row, sizeof(row), "%8s %12s %6s", "PHASE", "SAMPLES", "SHARE");
+    Output::writeLine(row);
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        if (counts[phase] == 0) continue;
+        snprintf(row, sizeof(row), "%8s %12llu %5.1f%%", PHASE_NAMES[phase], (unsigned long long) counts[phase],
+                 100.0 * counts[phase] / sum);
+        Output::writeLine(row);
+    }
+}
+
+/*
+ * Implementation notes: writeFolded
+ * ---------------------------------
+ * Every stack starts with a "basic" frame.  Samples taken while a
+ * program runs add a RUN frame and a frame for the line below it, so
+ * the flame graph groups the phases of each line together.  The stacks
+ * are sorted by line and phase to make the file reproducible.
+ */
+
+bool Sampler::writeFolded(const std::string &filename) {
+    std::vector<std::pair<uint64_t, uint64_t>> samples;
+    for (const SampleSlot &slot : table) {
+        uint64_t key = slot.key.load(std::memory_order_relaxed);
+        if (key != 0) samples.emplace_back(key, slot.count.load(std::memory_order_relaxed));
+    }
+    std::sort(samples.begin(), samples.end(), [](const auto &a, const auto &b) {
+        return int(a.first >> 32) != int(b.first >> 32) ? int(a.first >> 32) < int(b.first >> 32)
+                                                        : a.first < b.first;
+    });
+    FILE *file = fopen(filename.c_str(), "w");
+    if (file == nullptr) return false;
+    for (const auto &sample : samples) {
+        int line = int(sample.first >> 32);
+        const char *phase = PHASE_NAMES[uint32_t(sample.first) - 1];
+        if (line == NO_LINE) {
+            fprintf(file, "basic;%s %llu\n", phase, (unsigned long long) sample.second);
+        } else {
+            fprintf(file, "basic;RUN;line %d;%s %llu\n", line, phase, (unsigned long long) sample.second);
+        }
+    }
+    return fclose(file) == 0;
+}
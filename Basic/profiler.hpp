@@ -0,0 +1,378 @@
+/*
+ * File: profiler.h
+ * ----------------
+ * This interface exports the Profiler class, which counts how often
+ * each program line runs and how long it takes, the LineTimer template
+ * through which the RUN loop feeds it, and the Sampler class, which
+ * takes periodic samples of what the interpreter is doing.
+ */
+
+#ifndef _profiler_h
+#define _profiler_h
+
+#include <csignal>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+#include "program.hpp"
+
+/*
+ * Class: Profiler
+ * ---------------
+ * Collects per-line statistics across runs: the number of times each
+ * line was executed, the total time spent on it and the part of that
+ * time spent evaluating its expressions.  Lines are keyed by line
+ * number, so the figures survive edits to other lines.  Collection is
+ * off until the PROFILE ON command turns it on.
+ */
+
+class Profiler {
+
+public:
+
+/*
+ * Methods: setEnabled, isEnabled
+ * Usage: Profiler::setEnabled(true);
+ * ----------------------------------
+ * Turns collection on or off and reports whether it is on.  While it
+ * is on, RUN uses the instrumented tree-walking loop whatever engine
+ * is selected, since the other engines do not execute line by line.
+ */
+
+    static void setEnabled(bool flag);
+
+    static bool isEnabled();
+
+/*
+ * Method: reset
+ * Usage: Profiler::reset();
+ * -------------------------
+ * Discards all collected figures.
+ */
+
+    static void reset();
+
+/*
+ * Method: report
+ * Usage: Profiler::report();
+ * --------------------------
+ * Prints one row per executed line, hottest line first.  Nothing is
+ * printed if no figures have been collected.
+ */
+
+    static void report();
+
+/*
+ * Method: writeCsv
+ * Usage: if (Profiler::writeCsv(filename)) ...
+ * --------------------------------------------
+ * Writes the figures to the named file as comma-separated values with
+ * one header row, ordered by line number.  Returns false if the file
+ * cannot be written.
+ */
+
+    static bool writeCsv(const std::string &filename);
+
+/*
+ * Methods: beginRun, record, endRun
+ * Usage: Profiler::beginRun(code.size());
+ *        Profiler::record(pc, total, eval);
+ *        Profiler::endRun(code);
+ * -----------------------------------------
+ * Used by LineTimer.  During a run the figures are accumulated per
+ * instruction index in a flat array; endRun adds them to the per-line
+ * table.
+ */
+
+    static void beginRun(int size);
+
+    static void record(int pc, uint64_t total, uint64_t eval);
+
+    static void endRun(const std::vector<Instruction> &code);
+
+/*
+ * Method: now
+ * Usage: uint64_t t = Profiler::now();
+ * ------------------------------------
+ * Returns a monotonic time stamp in nanoseconds.
+ */
+
+    static uint64_t now();
+
+private:
+
+    struct Counter {
+        uint64_t count;
+        uint64_t total;
+        uint64_t eval;
+    };
+
+    struct LineCounter {
+        Counter counter;
+        std::string source;
+    };
+
+    static bool enabled;
+    static std::vector<Counter> current;
+    static std::map<int, LineCounter> lines;
+
+};
+
+inline void Profiler::record(int pc, uint64_t total, uint64_t eval) {
+    Counter &counter = current[pc];
+    counter.count++;
+    counter.total += total;
+    counter.eval += eval;
+}
+
+inline uint64_t Profiler::now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Class: LineTimer
+ * ----------------
+ * The RUN loop is instantiated once with LineTimer<false> and once
+ * with LineTimer<true>.  The loop calls enter at the start of every
+ * line and evaluates expressions through eval.  In the false version
+ * both are empty inline functions, so the ordinary loop compiles to
+ * exactly what it would be without a profiler.  The true version
+ * charges the time between two calls of enter to the earlier line,
+ * and the time inside eval to its expression time.
+ */
+
+template <bool ENABLED>
+class LineTimer {
+
+public:
+
+    explicit LineTimer(const std::vector<Instruction> &code) {}
+
+    void enter(int pc) {}
+
+    int eval(Expression *exp, EvalState &state) {
+        return exp->eval(state);
+    }
+
+};
+
+template <>
+class LineTimer<true> {
+
+public:
+
+    explicit LineTimer(const std::vector<Instruction> &code) : code(code), pc(-1), start(0), evalTime(0) {
+        Profiler::beginRun(code.size());
+    }
+
+    ~LineTimer() {
+        enter(-1);
+        Profiler::endRun(code);
+    }
+
+    void enter(int next) {
+        uint64_t time = Profiler::now();
+        if (pc >= 0) Profiler::record(pc, time - start, evalTime);
+        pc = next;
+        start = time;
+        evalTime = 0;
+    }
+
+    int eval(Expression *exp, EvalState &state) {
+        uint64_t time = Profiler::now();
+        int value = exp->eval(state);
+        evalTime += Profiler::now() - time;
+        return value;
+    }
+
+private:
+
+    const std::vector<Instruction> &code;
+    int pc;
+    uint64_t start;
+    uint64_t evalTime;
+
+};
+
+/*
+ * Type: SamplePhase
+ * -----------------
+ * The phases a sample is attributed to.  TOKENIZE covers splitting a
+ * program line into its tokens when it is entered or loaded, PARSE the
+ * building of its statement, EXECUTE the work of statements other than
+ * expression evaluation, EVAL the evaluation of expressions in the RUN
+ * loop and OUTPUT the writing of buffered output.  Everything else is
+ * OTHER.
+ */
+
+enum SamplePhase {
+    PHASE_OTHER, PHASE_TOKENIZE, PHASE_PARSE, PHASE_EXECUTE, PHASE_EVAL, PHASE_OUTPUT
+};
+
+/*
+ * Class: Sampler
+ * --------------
+ * A statistical profiler driven by the ITIMER_PROF interval timer.  The
+ * interpreter publishes the line being run and the current phase in two
+ * thread-local variables; on every SIGPROF the handler counts one sample
+ * for that pair in a fixed table, so the cost while sampling is a store
+ * at each phase change and an interrupt per tick.  The result can be
+ * written as folded stacks for flamegraph.pl.
+ */
+
+class Sampler {
+
+public:
+
+/*
+ * Constant: NO_LINE
+ * -----------------
+ * The line published while no program is running.
+ */
+
+    static const int NO_LINE = -1;
+
+/*
+ * Methods: start, stop, isRunning
+ * Usage: if (Sampler::start(hz)) ...
+ *        Sampler::stop();
+ * ----------------------------------
+ * Start discards earlier samples and starts taking the given number of
+ * samples per second of processor time; it returns false if the timer
+ * cannot be set.  Stop stops sampling and keeps the samples taken.
+ */
+
+    static bool start(int hz);
+
+    static void stop();
+
+    static bool isRunning();
+
+/*
+ * Method: reset
+ * Usage: Sampler::reset();
+ * ------------------------
+ * Discards all samples taken so far.
+ */
+
+    static void reset();
+
+/*
+ * Method: report
+ * Usage: Sampler::report();
+ * -------------------------
+ * Prints the number of samples in each phase, if any were taken.
+ */
+
+    static void report();
+
+/*
+ * Method: writeFolded
+ * Usage: if (Sampler::writeFolded(filename)) ...
+ * ----------------------------------------------
+ * Writes the samples to the named file in the folded stack format, one
+ * line per stack such as "basic;RUN;line 30;eval 17".  Returns false if
+ * the file cannot be written.
+ */
+
+    static bool writeFolded(const std::string &filename);
+
+/*
+ * Methods: setLine, setPhase
+ * Usage: Sampler::setLine(lineNumber);
+ *        SamplePhase saved = Sampler::setPhase(PHASE_PARSE);
+ * ------------------------------------------------------------
+ * Publish what the calling thread is doing.  SetPhase returns the phase
+ * it replaces so that the caller can restore it; SamplePhaseScope does
+ * so automatically.
+ */
+
+    static void setLine(int line);
+
+    static SamplePhase setPhase(SamplePhase phase);
+
+private:
+
+    static void handleSignal(int sig);
+
+    static bool running;
+    static thread_local volatile sig_atomic_t line;
+    static thread_local volatile sig_atomic_t phase;
+
+};
+
+inline void Sampler::setLine(int line) {
+    Sampler::line = line;
+}
+
+inline SamplePhase Sampler::setPhase(SamplePhase phase) {
+    SamplePhase saved = SamplePhase(Sampler::phase);
+    Sampler::phase = phase;
+    return saved;
+}
+
+/*
+ * Class: SamplePhaseScope
+ * -----------------------
+ * Sets the phase for the lifetime of the object and restores the
+ * previous phase when it goes out of scope.
+ */
+
+class SamplePhaseScope {
+
+public:
+
+    explicit SamplePhaseScope(SamplePhase phase) : saved(Sampler::setPhase(phase)) {}
+
+    ~SamplePhaseScope() {
+        Sampler::setPhase(saved);
+    }
+
+private:
+
+    SamplePhase saved;
+
+};
+
+/*
+ * Class: LineSampler
+ * ------------------
+ * The variant of LineTimer used by the RUN loop while the sampler is
+ * running.  It publishes the number of each line as it is entered and
+ * switches to PHASE_EVAL around expression evaluation.
+ */
+
+class LineSampler {
+
+public:
+
+    explicit LineSampler(const std::vector<Instruction> &code) : code(code), saved(Sampler::setPhase(PHASE_EXECUTE)) {}
+
+    ~LineSampler() {
+        Sampler::setLine(Sampler::NO_LINE);
+        Sampler::setPhase(saved);
+    }
+
+    void enter(int pc) {
+        Sampler::setLine(code[pc].lineNumber);
+    }
+
+    int eval(Expression *exp, EvalState &state) {
+        Sampler::setPhase(PHASE_EVAL);
+        int value = exp->eval(state);
+        Sampler::setPhase(PHASE_EXECUTE);
+        return value;
+    }
+
+private:
+
+    const std::vector<Instruction> &code;
+    SamplePhase saved;
+
+};
+
+#endif
@@ -8,20 +8,34 @@
  * the performance guarantees specified in the assignment.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <exception>
+#include <thread>
+#include "output.hpp"
+#include "profiler.hpp"
 #include "program.hpp"
 
 
 
 Program::Program() = default;
 
-Program::~Program() {
-    for (auto i : program) {
-        delete i.second.first;
-    }
-}
+Program::~Program() = default;
+
+/*
+ * Implementation notes: clear
+ * ---------------------------
+ * All parsed statements live in the arena, so they are released in one
+ * step without visiting the lines.
+ */
 
 void Program::clear() {
     program.clear();
+    code.clear();
+    staleLines.clear();
+    arena.release();
+    compiled = false;
     return;
 }
 
@@ -30,177 +44,150 @@ void Program::addSourceLine(int lineNumber, const std::string &line) {
     scanner.ignoreComments();
     scanner.ignoreWhitespace();
     scanner.scanNumbers();
-    scanner.setInput(line);
+    scanner.setInputView(line);
     if (scanner.hasMoreTokens()) {
         std::string token = scanner.nextToken();
-        if (token == "REM") {
-            Statement *sta = nullptr;
-            delete program[lineNumber].first;
-            program[lineNumber] = {sta, line};
-            return;
-        }
-        if (token == "LET") {
-            if (!scanner.hasMoreTokens()) {
-                std::cout << "SYNTAX ERROR" << std::endl;
-                return;
-            } else {
-                std::string variable = scanner.nextToken();
-                if (scanner.nextToken()[0] == '=') {
-                    if (scanner.hasMoreTokens()) {
-                        std::string ex;
-                        while (scanner.hasMoreTokens()) {
-                            ex += scanner.nextToken() + ' ';
-                        }
-                        TokenScanner expp;
-                        expp.ignoreWhitespace();
-                        expp.scanNumbers();
-                        expp.setInput(ex);
-                        Expression *exp = parseExp(expp);
-                        Statement *sta = new LetStatement(variable, exp);
-                        delete program[lineNumber].first;
-                        program[lineNumber] = {sta, line};
-                    } else {
-                        std::cout << "SYNTAX ERROR" << std::endl;
-                        return;
-                    }
-                }
-            }
-            return;
+        Statement *sta = parseStatement(token, scanner, arena, PROGRAM_MODE);
+        if (sta != nullptr) {
+            storeLine(lineNumber, sta, line);
         }
-        if (token == "GOTO") {
-            if (!scanner.hasMoreTokens()) {
-                std::cout << "SYNTAX ERROR" << std::endl;
-                return;
+        return;
+    }
+    else {
+        removeSourceLine(lineNumber);
+        return;
+    }
+    
+}
+
+/*
+ * Implementation notes: loadSource
+ * --------------------------------
+ * Loading runs in two phases.  First the text is cut into lines and
+ * every line is joined and parsed into a ParsedLine without touching
+ * the program; this phase shares nothing but the slot table, so with
+ * enough lines it is spread over worker threads that take chunks of
+ * CHUNK_LINES lines from an atomic counter, each allocating into its
+ * own arena.  The arenas are then adopted by the program, and a single
+ * pass applies the parsed lines in text order exactly as addSourceLine
+ * would have, which keeps duplicates, deletions, messages and errors
+ * in their sequential order.
+ */
+
+struct ParsedLine {
+    int lineNumber;
+    std::string source;
+    Statement *stmt;
+    bool blank;                  /* No tokens at all: skipped       */
+    bool erase;                  /* Bare line number: deletes line  */
+    std::exception_ptr error;
+};
+
+static const int CHUNK_LINES = 1024;
+static const int MIN_PARALLEL_LINES = 4 * CHUNK_LINES;
+static const int INCREMENTAL_LINES = 64;
+
+static void parseLines(const std::string_view *lines, ParsedLine *parsed, int count, Arena &arena) {
+    TokenScanner numbers;
+    numbers.ignoreWhitespace();
+    numbers.scanNumbers();
+    TokenScanner scanner;
+    scanner.ignoreComments();
+    scanner.ignoreWhitespace();
+    scanner.scanNumbers();
+    SamplePhaseScope phase(PHASE_TOKENIZE);
+    for (int i = 0; i < count; i++) {
+        ParsedLine &line = parsed[i];
+        line.stmt = nullptr;
+        line.blank = false;
+        line.erase = false;
+        try {
+            Sampler::setPhase(PHASE_TOKENIZE);
+            numbers.setInputView(lines[i]);
+            Token token = numbers.next();
+            if (token.text.empty()) {
+                line.blank = true;
+                continue;
             }
-            int value;
-            std::string input = scanner.nextToken();
-            if (scanner.hasMoreTokens()) {
-                std::cout << "SYNTAX ERROR" << std::endl;
-                return;
+            const char *end = token.text.data() + token.text.length();
+            if (token.type != NUMBER || std::from_chars(token.text.data(), end, line.lineNumber).ec != std::errc()) {
+                error("SYNTAX ERROR");
             }
-            try {
-                value = std::stoi(input);
-                Statement *sta = new GotoStatement(value);
-                delete program[lineNumber].first;
-                program[lineNumber] = {sta, line};
-            } 
-            catch(std::exception& e) {
-                std::cout << "SYNTAX ERROR" << std::endl;
-                return;
+            for (token = numbers.next(); !token.text.empty(); token = numbers.next()) {
+                line.source.append(token.text);
+                line.source += ' ';
             }
-            return;
-        }
-        if (token == "IF") {
+            Sampler::setPhase(PHASE_PARSE);
+            scanner.setInputView(line.source);
             if (!scanner.hasMoreTokens()) {
-                std::cout << "SYNTAX ERROR" << std::endl;
-                return;
-            } else {
-                std::string left;
-                std::string right;
-                char op;
-                int target;
-                while (true) {
-                    std::string tmp = scanner.nextToken();
-                    if (tmp[0] == '=' || tmp[0] == '<' || tmp[0] == '>') {
-                        op = tmp[0];
-                        break;
-                    }
-                    left += tmp + ' ';
-                }
-                TokenScanner expp;
-                expp.ignoreWhitespace();
-                expp.scanNumbers();
-                expp.setInput(left);
-                Expression *lhs = parseExp(expp);
-                while (true) {
-                    std::string tmp = scanner.nextToken();
-                    if (tmp == "THEN") {
-                        break;
-                    }
-                    right += tmp + ' ';
-                }
-                TokenScanner exppp;
-                exppp.ignoreWhitespace();
-                exppp.scanNumbers();
-                exppp.setInput(right);
-                Expression *rhs = parseExp(exppp);
-                std::string ttmp = scanner.nextToken();
-                try {
-                    target = std::stoi(ttmp);
-                } 
-                catch(std::exception& e) {
-                    std::cout << "SYNTAX ERROR" << std::endl;
-                    return;
-                }
-                if (scanner.hasMoreTokens()) {
-                    std::cout << "SYNTAX ERROR" << std::endl;
-                    return;
-                }
-                Statement *sta = new IfStatement(lhs, rhs, op, target);
-                delete program[lineNumber].first;
-                program[lineNumber] = {sta, line};
+                line.erase = true;
+                continue;
             }
-            return;
+            std::string keyword = scanner.nextToken();
+            line.stmt = tryParseStatement(keyword, scanner, arena, PROGRAM_MODE);
+        } catch (...) {
+            line.error = std::current_exception();
         }
-        if (token == "PRINT") {
-            if (!scanner.hasMoreTokens()) {
-                std::cout << "SYNTAX ERROR" << std::endl;
-                return;
-            } else {
-                std::string ex;
-                while (scanner.hasMoreTokens()) {
-                    ex += scanner.nextToken() + ' ';
+    }
+}
+
+bool Program::loadSource(std::string_view text) {
+    std::vector<std::string_view> lines;
+    while (!text.empty()) {
+        size_t newline = text.find('\n');
+        lines.push_back(text.substr(0, newline));
+        text.remove_prefix(newline == std::string_view::npos ? text.length() : newline + 1);
+    }
+    int count = lines.size();
+    if (count > INCREMENTAL_LINES) {
+        compiled = false;
+    }
+    std::vector<ParsedLine> parsed(count);
+    int workers = std::min<int>(std::thread::hardware_concurrency(), count / CHUNK_LINES);
+    if (count < MIN_PARALLEL_LINES || workers < 2) {
+        parseLines(lines.data(), parsed.data(), count, arena);
+    } else {
+        std::vector<Arena> arenas(workers);
+        std::vector<std::thread> threads;
+        std::atomic<int> next(0);
+        for (int w = 0; w < workers; w++) {
+            threads.emplace_back([&, w] {
+                int first;
+                while ((first = next.fetch_add(CHUNK_LINES)) < count) {
+                    int n = std::min(CHUNK_LINES, count - first);
+                    parseLines(lines.data() + first, parsed.data() + first, n, arenas[w]);
                 }
-                TokenScanner expp;
-                expp.ignoreWhitespace();
-                expp.scanNumbers();
-                expp.setInput(ex);
-                Expression *exp = parseExp(expp);
-                Statement *sta = new PrintStatement(exp);
-                delete program[lineNumber].first;
-                program[lineNumber] = {sta, line};
-            }
-            return;
+            });
         }
-        if (token == "INPUT") {
-            if (!scanner.hasMoreTokens()) {
-                std::cout << "SYNTAX ERROR" << std::endl;
-                return;
-            } else {
-                std::string variable = scanner.nextToken();
-                if (scanner.hasMoreTokens()) {
-                    std::cout << "SYNTAX ERROR" << std::endl;
-                    return;
-                }
-                Statement *sta = new InputStatement(variable);
-                delete program[lineNumber].first;
-                program[lineNumber] = {sta, line};
-            }
-            return;
+        for (std::thread &thread : threads) {
+            thread.join();
         }
-        if (token == "END") {
-            if (scanner.hasMoreTokens()) {
-                std::cout << "SYNTAX ERROR" << std::endl;
-                return;
-            }
-            Statement *sta = new EndStatement();
-            delete program[lineNumber].first;
-            program[lineNumber] = {sta, line};
-            return;
+        for (Arena &worker : arenas) {
+            arena.adopt(worker);
         }
-        std::cout << "SYNTAX ERROR" << std::endl;
-        return;
     }
-    else {
-        if (program.find(lineNumber) == program.end()) {
-            return;
+    bool clean = true;
+    for (ParsedLine &line : parsed) {
+        if (line.error) {
+            std::rethrow_exception(line.error);
+        }
+        if (line.blank) {
+            continue;
+        }
+        if (line.erase) {
+            removeSourceLine(line.lineNumber);
+        } else if (line.stmt == nullptr) {
+            Output::writeLine("SYNTAX ERROR");
+            clean = false;
         } else {
-            delete program[lineNumber].first;
-            program.erase(lineNumber);
-            return;
+            storeLine(line.lineNumber, line.stmt, std::move(line.source));
         }
     }
-    
+    return clean;
+}
+
+void Program::addParsedLine(int lineNumber, std::string line, Statement *stmt) {
+    storeLine(lineNumber, stmt, std::move(line));
 }
 
 void Program::removeSourceLine(int lineNumber) {
@@ -209,6 +196,9 @@ void Program::removeSourceLine(int lineNumber) {
         return;
     } else {
         program.erase(ff);
+        if (compiled) {
+            unlinkLine(lineNumber);
+        }
         return;
     }
 }
@@ -228,6 +218,7 @@ void Program::setParsedStatement(int lineNumber, Statement *stmt) {
         return;
     }
     ff->second.first = stmt;
+    staleLines.push_back(lineNumber);
     return;
 }
 
@@ -242,6 +233,10 @@ Statement *Program::getParsedStatement(int lineNumber) {
     return sta;
 }
 
+Arena &Program::getArena() {
+    return arena;
+}
+
 int Program::getFirstLineNumber() {
     auto minimal = this->program.begin();
     if (minimal == program.end()) {
@@ -264,7 +259,139 @@ int Program::getNextLineNumber(int lineNumber) {
     return value;
 }
 
-//more func to add
-//todo
+/*
+ * Implementation notes: compile, getInstructionIndex
+ * --------------------------------------------------
+ * The compiled array mirrors the line map in ascending order, so a
+ * line number can be located with a binary search over contiguous
+ * memory.  REM lines keep their slot so that a jump to them falls
+ * through to the following line.
+ *
+ * Once compiled, the array is kept in step with the line map.  A new
+ * line number is inserted into its slot and a removed one erased from
+ * it; the jumps are then fixed by one pass over the array that shifts
+ * the targets past the slot, without looking any line up again.  Only
+ * jumps to the line itself are resolved anew: dangling jumps to a new
+ * line are linked, and jumps to a removed line are cut.  Each change
+ * therefore costs a move of the array rather than a rebuild with a
+ * binary search per jump.  loadSource gives up the array when it adds
+ * more than INCREMENTAL_LINES lines, since one rebuild then costs less
+ * than many shifts.  Replacing the statement of an existing line keeps
+ * the layout intact; such lines are queued in staleLines and only
+ * their own slot is patched and relinked.
+ */
+
+static int jumpTarget(const Instruction &ins) {
+    if (ins.type == GOTO_STMT) {
+        return static_cast<GotoStatement *>(ins.stmt)->getlinetarget();
+    } else if (ins.type == IF_STMT) {
+        return static_cast<IfStatement *>(ins.stmt)->get_target_line();
+    }
+    return -1;
+}
+
+const std::vector<Instruction> &Program::compile() {
+    if (!compiled) {
+        code.clear();
+        code.reserve(program.size());
+        for (auto &entry : program) {
+            code.push_back({entry.first, REM_STMT, entry.second.first, &entry.second.second, -1});
+        }
+        for (Instruction &ins : code) {
+            link(ins);
+        }
+        staleLines.clear();
+        compiled = true;
+        return code;
+    }
+    for (int lineNumber : staleLines) {
+        int pc = getInstructionIndex(lineNumber);
+        if (pc == (int) code.size()) {
+            continue;
+        }
+        code[pc].stmt = program[lineNumber].first;
+        link(code[pc]);
+    }
+    staleLines.clear();
+    return code;
+}
+
+void Program::linkLine(int lineNumber, Statement *stmt, const std::string *source) {
+    int pc = std::lower_bound(code.begin(), code.end(), lineNumber,
+                              [](const Instruction &ins, int line) { return ins.lineNumber < line; })
+             - code.begin();
+    for (Instruction &ins : code) {
+        if (ins.target >= pc) {
+            ins.target++;
+        }
+    }
+    code.insert(code.begin() + pc, {lineNumber, REM_STMT, stmt, source, -1});
+    link(code[pc]);
+    for (Instruction &ins : code) {
+        if (ins.target == -1 && jumpTarget(ins) == lineNumber) {
+            ins.target = pc;
+        }
+    }
+}
 
+void Program::unlinkLine(int lineNumber) {
+    int pc = getInstructionIndex(lineNumber);
+    if (pc == (int) code.size()) {
+        return;
+    }
+    code.erase(code.begin() + pc);
+    for (Instruction &ins : code) {
+        if (ins.target == pc) {
+            ins.target = -1;
+        } else if (ins.target > pc) {
+            ins.target--;
+        }
+    }
+}
+
+int Program::getInstructionIndex(int lineNumber) {
+    auto ff = std::lower_bound(code.begin(), code.end(), lineNumber,
+                               [](const Instruction &ins, int line) { return ins.lineNumber < line; });
+    if (ff == code.end() || ff->lineNumber != lineNumber) {
+        return code.size();
+    }
+    return ff - code.begin();
+}
+
+/*
+ * Implementation notes: storeLine, link
+ * -------------------------------------
+ * storeLine is the single place where addSourceLine installs a parsed
+ * line, so it is also where the link table learns about the change.
+ * A replaced statement stays in the arena until the program is
+ * cleared.
+ * link resolves the jump target of one instruction to an index into
+ * the compiled array, or -1 if the target line does not exist.
+ */
+
+void Program::storeLine(int lineNumber, Statement *stmt, std::string line) {
+    auto ff = program.find(lineNumber);
+    if (ff == program.end()) {
+        ff = program.emplace(lineNumber, std::make_pair(stmt, std::move(line))).first;
+        if (compiled) {
+            linkLine(lineNumber, stmt, &ff->second.second);
+        }
+        return;
+    }
+    ff->second = {stmt, std::move(line)};
+    staleLines.push_back(lineNumber);
+}
+
+void Program::link(Instruction &ins) {
+    ins.type = ins.stmt->getType();
+    ins.target = -1;
+    int targetLine = jumpTarget(ins);
+    if (targetLine < 0) {
+        return;
+    }
+    int pc = getInstructionIndex(targetLine);
+    if (pc != (int) code.size()) {
+        ins.target = pc;
+    }
+}
 
@@ -9,14 +9,39 @@
 #define _program_h
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <set>
 #include <map>
 #include <unordered_map>
+#include "arena.hpp"
 #include "statement.hpp"
 
 class Statement;
 
+/*
+ * Type: Instruction
+ * -----------------
+ * One entry of the compiled form of a program.  The compiled form
+ * is a contiguous array holding one instruction per stored line in
+ * ascending line-number order, so that the interpreter can step
+ * through the program with an integer program counter instead of
+ * walking the line map.  The source pointer refers to the text
+ * kept in the line map and stays valid until the program changes.
+ * The type field caches the tag of the statement for dispatch.  For
+ * GOTO and IF lines, target holds the index of the instruction to
+ * jump to, resolved once at link time; it is -1 if the target line
+ * does not exist or the line does not jump.
+ */
+
+struct Instruction {
+    int lineNumber;
+    StatementType type;
+    Statement *stmt;
+    const std::string *source;
+    int target;
+};
+
 /*
  * This class stores the lines in a BASIC program.  Each line
  * in the program is stored in order according to its line number.
@@ -28,6 +53,10 @@ class Statement;
  *
  * 2. The parsed representation of that statement, which is a
  *    pointer to a Statement.
+ *
+ * The parsed statements and their expressions are allocated in an
+ * arena owned by the program, which releases them all at once when
+ * the program is cleared or destroyed.
  */
 
 class Program {
@@ -74,14 +103,43 @@ public:
 
     void addSourceLine(int lineNumber, const std::string& line);
 
+/*
+ * Method: loadSource
+ * Usage: program.loadSource(text);
+ * --------------------------------
+ * Adds every line of text, each of which must begin with a line number,
+ * with the same effect as entering the lines one at a time: lines are
+ * stored in token-joined form, a later line with the same number
+ * replaces an earlier one, a bare line number deletes the line,
+ * SYNTAX ERROR is printed for each malformed statement in turn and an
+ * error raised by a line is raised after all lines before it have been
+ * added.  Blank lines are skipped and a line without a line number
+ * raises SYNTAX ERROR.  Returns false if any statement was malformed.
+ * Large inputs are parsed on a pool of worker threads; the results are
+ * still installed in the order of the text.
+ */
+
+    bool loadSource(std::string_view text);
+
+/*
+ * Method: addParsedLine
+ * Usage: program.addParsedLine(lineNumber, line, stmt);
+ * -----------------------------------------------------
+ * Adds a line whose statement has already been built in the arena
+ * returned by getArena, replacing any existing line with that number.
+ * This is how a program is restored without parsing its text.
+ */
+
+    void addParsedLine(int lineNumber, std::string line, Statement *stmt);
+
 /*
  * Method: removeSourceLine
  * Usage: program.removeSourceLine(lineNumber);
  * --------------------------------------------
- * Removes the line with the specified number from the program,
- * freeing the memory associated with any parsed representation.
- * If no such line exists, this method simply returns without
- * performing any action.
+ * Removes the line with the specified number from the program.
+ * The memory of its parsed representation is reclaimed when the
+ * program is cleared.  If no such line exists, this method simply
+ * returns without performing any action.
  */
 
     void removeSourceLine(int lineNumber);
@@ -102,8 +160,8 @@ public:
  * ----------------------------------------------------
  * Adds the parsed representation of the statement to the statement
  * at the specified line number.  If no such line exists, this
- * method raises an error.  If a previous parsed representation
- * exists, the memory for that statement is reclaimed.
+ * method raises an error.  The statement must have been allocated
+ * in the arena returned by getArena.
  */
 
     void setParsedStatement(int lineNumber, Statement *stmt);
@@ -119,6 +177,15 @@ public:
 
     Statement *getParsedStatement(int lineNumber);
 
+/*
+ * Method: getArena
+ * Usage: Statement *stmt = new (program.getArena()) EndStatement();
+ * -----------------------------------------------------------------
+ * Returns the arena that owns the parsed statements of the program.
+ */
+
+    Arena &getArena();
+
 /*
  * Method: getFirstLineNumber
  * Usage: int lineNumber = program.getFirstLineNumber();
@@ -140,14 +207,46 @@ public:
 
     int getNextLineNumber(int lineNumber);
 
-    //more func to add
-    //todo
+/*
+ * Method: compile
+ * Usage: const std::vector<Instruction> &code = program.compile();
+ * ----------------------------------------------------------------
+ * Lowers the stored lines into a flat instruction array, links every
+ * jump to the index of its target and returns the array.  The array
+ * is cached and kept up to date as lines are added or removed, which
+ * moves the later instructions and their jump targets; replacing an
+ * existing line only relinks that line.
+ */
+
+    const std::vector<Instruction> &compile();
+
+/*
+ * Method: getInstructionIndex
+ * Usage: int pc = program.getInstructionIndex(lineNumber);
+ * --------------------------------------------------------
+ * Returns the index in the compiled array of the instruction for the
+ * specified line number.  If no such line exists, this method returns
+ * the size of the array, which stops the interpreter.  The program
+ * must have been compiled.
+ */
+
+    int getInstructionIndex(int lineNumber);
 
 private:
 
-    // Fill this in with whatever types and instance variables you need
-    //todo
     std::map <int, std::pair<Statement*, std::string>> program;
+    Arena arena;                       /* Owns all parsed statements   */
+    std::vector<Instruction> code;     /* Compiled form of the program */
+    std::vector<int> staleLines;       /* Lines replaced since linking */
+    bool compiled = false;             /* False if code must be rebuilt */
+
+    void storeLine(int lineNumber, Statement *stmt, std::string line);
+
+    void linkLine(int lineNumber, Statement *stmt, const std::string *source);
+
+    void unlinkLine(int lineNumber);
+
+    void link(Instruction &ins);
 };
 
 #endif
@@ -7,7 +7,16 @@
  * BASIC statements.
  */
 
+#include <charconv>
+#include <cstring>
 #include "statement.hpp"
+#include "cache.hpp"
+#include "input.hpp"
+#include "jit.hpp"
+#include "output.hpp"
+#include "profiler.hpp"
+#include "program.hpp"
+#include "threaded.hpp"
 
 
 /* Implementation of the Statement class */
@@ -18,103 +27,123 @@ Statement::~Statement() = default;
 
 //todo
 REMStatement::REMStatement() {}
-void REMStatement::execute(EvalState &state, Program &pro) {
-    return;
+ControlTransfer REMStatement::execute(EvalState &state, Program &pro) {
+    return PROCEED;
 }
-
-LetStatement::LetStatement(std::string variable, Expression *exp) : var(variable), exp(exp) {}
-LetStatement::~LetStatement() {
-    delete exp;
+StatementType REMStatement::getType() {
+    return REM_STMT;
 }
-void LetStatement::execute(EvalState &state, Program &pro) {
-    if (var == "LET") {
-        std::cout << "SYNTAX ERROR" << std::endl;
-        return;
+
+LetStatement::LetStatement(std::string variable, Expression *exp)
+        : slot(EvalState::getSlot(variable)), illegal(variable == "LET"), exp(exp) {}
+ControlTransfer LetStatement::execute(EvalState &state, Program &pro) {
+    if (illegal) {
+        Output::writeLine("SYNTAX ERROR");
+        return PROCEED;
     }
     int value = exp->eval(state);
-    state.setValue(var, value);
-    return;
+    state.setValue(slot, value);
+    return PROCEED;
+}
+StatementType LetStatement::getType() {
+    return LET_STMT;
+}
+int LetStatement::getSlot() {
+    return slot;
+}
+bool LetStatement::isIllegal() {
+    return illegal;
+}
+Expression *LetStatement::getExp() {
+    return exp;
 }
 
 PrintStatement::PrintStatement(Expression *exp) : exp(exp) {}
-PrintStatement::~PrintStatement() {
-    delete exp;
-}
-void PrintStatement::execute(EvalState &state, Program &pro) {
+ControlTransfer PrintStatement::execute(EvalState &state, Program &pro) {
     int value = exp->eval(state);
     if (value != 114514) {
-        std::cout << value << std::endl;
+        Output::writeLine(value);
     }
-    return;
+    return PROCEED;
+}
+StatementType PrintStatement::getType() {
+    return PRINT_STMT;
+}
+Expression *PrintStatement::getExp() {
+    return exp;
 }
 
-InputStatement::InputStatement(std::string str) : variable(str) {}
-void InputStatement::execute(EvalState &state, Program &pro) {
+InputStatement::InputStatement(std::string str) : slot(EvalState::getSlot(str)) {}
+ControlTransfer InputStatement::execute(EvalState &state, Program &pro) {
     int value;
     while (true) {
-        std::cout << " ? ";
-        std::string input;
-        getline(std::cin, input);
+        Output::write(" ? ");
+        std::string_view input;
+        if (!Input::readLine(input)) {
+            return STOP;
+        }
+        if (Input::parseInteger(input, value)) {
+            break;
+        }
         TokenScanner scanner;
         scanner.ignoreWhitespace();
         scanner.scanNumbers();
-        scanner.setInput(input);
+        scanner.setInputView(input);
         std::string token = scanner.nextToken();
         bool negative = false;
         if (token[0] == '-') {
             token = scanner.nextToken();
             negative = true;
         }
-        if (scanner.hasMoreTokens() || scanner.getTokenType(token) != NUMBER) {
-            std::cout << "INVALID NUMBER" << std::endl;
+        if (scanner.hasMoreTokens() || scanner.getTokenType(token) != NUMBER
+            || token.find('.') != std::string::npos) {
+            Output::writeLine("INVALID NUMBER");
+            continue;
+        }
+        if (std::from_chars(token.data(), token.data() + token.length(), value).ec != std::errc()) {
+            Output::writeLine("INVALID NUMBER");
             continue;
-        } else {
-            bool flag = true;
-            for (int i = 0; i < token.length(); i++) {
-                if (token[i] == '.') {
-                    flag = false;
-                }
-            }
-            if (flag) {
-                value = std::stoi(token);
-                if (negative) {
-                    value = -value;
-                }
-                break;
-            } else {
-                std::cout << "INVALID NUMBER" << std::endl;
-                continue;
-            }
         }
+        if (negative) {
+            value = -value;
+        }
+        break;
     }
-    state.setValue(variable, value);
+    state.setValue(slot, value);
+    return PROCEED;
+}
+StatementType InputStatement::getType() {
+    return INPUT_STMT;
+}
+int InputStatement::getSlot() {
+    return slot;
 }
 
 EndStatement::EndStatement() {}
-void EndStatement::execute(EvalState &state, Program &pro) {}
+ControlTransfer EndStatement::execute(EvalState &state, Program &pro) {
+    return STOP;
+}
+StatementType EndStatement::getType() {
+    return END_STMT;
+}
 
 GotoStatement::GotoStatement(int line) : linetarget(line) {}
-void GotoStatement::execute(EvalState &state, Program &pro) {
-    if (pro.getSourceLine(linetarget).empty()) {
-        std::cout << "LINE NUMBER ERROR" << std::endl;
-        return;
-    }
+ControlTransfer GotoStatement::execute(EvalState &state, Program &pro) {
+    return JUMP;
+}
+StatementType GotoStatement::getType() {
+    return GOTO_STMT;
 }
 int GotoStatement::getlinetarget() {
     return linetarget;
 }
 
 IfStatement::IfStatement(Expression *left, Expression *right, char s, int targetline) : lhs(left), rhs(right), op(s), target(targetline) {}
-IfStatement::~IfStatement() {
-    delete lhs;
-    delete rhs;
+ControlTransfer IfStatement::execute(EvalState &state, Program &pro) {
+    return condition(state, pro) ? JUMP : PROCEED;
 }
-void IfStatement::execute(EvalState &state, Program &pro) {
-    if (pro.getSourceLine(target).empty()) {
-        std::cout << "LINE NUMBER ERROR" << std::endl;
-        return;
-    }
-    return;
+StatementType IfStatement::getType() {
+    return IF_STMT;
 }
 bool IfStatement::condition(EvalState &state, Program &pro) {
     bool flag = false;
@@ -134,69 +163,452 @@ bool IfStatement::condition(EvalState &state, Program &pro) {
 int IfStatement::get_target_line() {
     return target;
 }
+Expression *IfStatement::getLHS() {
+    return lhs;
+}
+Expression *IfStatement::getRHS() {
+    return rhs;
+}
+char IfStatement::getOp() {
+    return op;
+}
 
 RunStatement::RunStatement() {}
-void RunStatement::execute(EvalState &state, Program &pro) {
-    int cur_line_number = pro.getFirstLineNumber();
-    if (cur_line_number == -1) {
-        return;
-    }
-    while (cur_line_number != -1) {
-        Statement *sta = pro.getParsedStatement(cur_line_number);
-        if (sta == nullptr) {
-            cur_line_number = pro.getNextLineNumber(cur_line_number);
-            continue;
-        }
-        if (pro.getSourceLine(cur_line_number)[0] == 'G') {
-            sta->execute(state, pro);
-            GotoStatement *newsta = dynamic_cast<GotoStatement *>(sta);
-            cur_line_number = newsta->getlinetarget();
-            continue;
-        }
-        if (pro.getSourceLine(cur_line_number)[0] == 'I' && pro.getSourceLine(cur_line_number)[1] == 'F') {
-            sta->execute(state, pro);
-            IfStatement *newsta = dynamic_cast<IfStatement *>(sta);
-            if (newsta->condition(state, pro)) {
-                cur_line_number = newsta->get_target_line();
-            } else {
-                cur_line_number = pro.getNextLineNumber(cur_line_number);
+
+/*
+ * Implementation notes: RunStatement::execute
+ * -------------------------------------------
+ * The interpreter steps through the compiled program and dispatches on
+ * the statement tag cached in each instruction.  GOTO and END are
+ * handled inline, and so are LET, PRINT and IF, whose expressions are
+ * evaluated through the LineTimer; the remaining statements report the
+ * control transfer from execute.  A jump whose target did not link
+ * reports LINE NUMBER ERROR before the condition is evaluated and stops
+ * the program if it is taken.  When the THREADED or JIT engine is
+ * selected the whole run is handed to runThreaded or runJit instead,
+ * unless the profiler or the sampler is on, in which case the loop is
+ * instantiated with the recording LineTimer or with LineSampler.
+ */
+
+template <typename Timer>
+static void runProgram(EvalState &state, Program &pro) {
+    const std::vector<Instruction> &code = pro.compile();
+    Timer timer(code);
+    int size = code.size();
+    int pc = 0;
+    while (pc < size) {
+        const Instruction &ins = code[pc];
+        timer.enter(pc);
+        switch (ins.type) {
+            case REM_STMT:
+                pc++;
+                break;
+            case END_STMT:
+                return;
+            case GOTO_STMT:
+                if (ins.target == -1) {
+                    Output::writeLine("LINE NUMBER ERROR");
+                    return;
+                }
+                pc = ins.target;
+                break;
+            case LET_STMT: {
+                LetStatement *let = static_cast<LetStatement *>(ins.stmt);
+                if (let->isIllegal()) {
+                    Output::writeLine("SYNTAX ERROR");
+                } else {
+                    int value = timer.eval(let->getExp(), state);
+                    state.setValue(let->getSlot(), value);
+                }
+                pc++;
+                break;
             }
-            continue;
-        }
-        if (pro.getSourceLine(cur_line_number)[0] == 'E') {
-            break;
+            case PRINT_STMT: {
+                int value = timer.eval(static_cast<PrintStatement *>(ins.stmt)->getExp(), state);
+                if (value != 114514) {
+                    Output::writeLine(value);
+                }
+                pc++;
+                break;
+            }
+            case IF_STMT: {
+                if (ins.target == -1) {
+                    Output::writeLine("LINE NUMBER ERROR");
+                }
+                IfStatement *cond = static_cast<IfStatement *>(ins.stmt);
+                int left = timer.eval(cond->getLHS(), state);
+                int right = timer.eval(cond->getRHS(), state);
+                char op = cond->getOp();
+                if (op == '=' ? left == right : op == '<' ? left < right : op == '>' && left > right) {
+                    if (ins.target == -1) {
+                        return;
+                    }
+                    pc = ins.target;
+                } else {
+                    pc++;
+                }
+                break;
+            }
+            default:
+                if (ins.stmt->execute(state, pro) == STOP) {
+                    return;
+                }
+                pc++;
+                break;
         }
-        sta->execute(state, pro);
-        cur_line_number = pro.getNextLineNumber(cur_line_number);
     }
 }
 
+ControlTransfer RunStatement::execute(EvalState &state, Program &pro) {
+    if (Profiler::isEnabled()) {
+        runProgram<LineTimer<true>>(state, pro);
+    } else if (Sampler::isRunning()) {
+        runProgram<LineSampler>(state, pro);
+    } else if (state.getEngine() == THREADED) {
+        runThreaded(state, pro);
+    } else if (state.getEngine() == JIT) {
+        runJit(state, pro);
+    } else {
+        runProgram<LineTimer<false>>(state, pro);
+    }
+    return PROCEED;
+}
+StatementType RunStatement::getType() {
+    return RUN_STMT;
+}
+
 ListStatement::ListStatement() {}
-void ListStatement::execute(EvalState &state, Program &pro) {
+ControlTransfer ListStatement::execute(EvalState &state, Program &pro) {
     int cur_line_number = pro.getFirstLineNumber();
     if (cur_line_number == -1) {
-        return;
+        return PROCEED;
     }
     while (cur_line_number != -1) {
-        std::cout << cur_line_number << ' ';
-        std::cout << pro.getSourceLine(cur_line_number) << std::endl;
+        Output::write(cur_line_number);
+        Output::write(" ");
+        Output::writeLine(pro.getSourceLine(cur_line_number));
         cur_line_number = pro.getNextLineNumber(cur_line_number);
     }
+    return PROCEED;
+}
+StatementType ListStatement::getType() {
+    return LIST_STMT;
 }
 
 QuitStatement::QuitStatement() {}
-void QuitStatement::execute(EvalState &state, Program &pro) {
+ControlTransfer QuitStatement::execute(EvalState &state, Program &pro) {
+    Output::flush();
     exit(0);
 }
+StatementType QuitStatement::getType() {
+    return QUIT_STMT;
+}
 
 ClearStatement::ClearStatement() {}
-void ClearStatement::execute(EvalState &state, Program &pro) {
+ControlTransfer ClearStatement::execute(EvalState &state, Program &pro) {
     pro.clear();
     state.Clear();
+    return PROCEED;
+}
+StatementType ClearStatement::getType() {
+    return CLEAR_STMT;
 }
 
 HelpStatement::HelpStatement() {}
-void HelpStatement::execute(EvalState &state, Program &pro) {
-    std::cout << "THANK GOD" << std::endl;
+ControlTransfer HelpStatement::execute(EvalState &state, Program &pro) {
+    Output::writeLine("THANK GOD");
+    return PROCEED;
+}
+StatementType HelpStatement::getType() {
+    return HELP_STMT;
+}
+
+SaveStatement::SaveStatement(const char *file) : filename(file) {}
+ControlTransfer SaveStatement::execute(EvalState &state, Program &pro) {
+    if (!saveSnapshot(filename, pro, state)) {
+        Output::writeLine("FILE ERROR");
+    }
+    return PROCEED;
+}
+StatementType SaveStatement::getType() {
+    return SAVE_STMT;
+}
+
+LoadStatement::LoadStatement(const char *file) : filename(file) {}
+ControlTransfer LoadStatement::execute(EvalState &state, Program &pro) {
+    if (!loadSnapshot(filename, pro, state)) {
+        Output::writeLine("FILE ERROR");
+    }
+    return PROCEED;
 }
+StatementType LoadStatement::getType() {
+    return LOAD_STMT;
+}
+
+ProfileStatement::ProfileStatement(ProfileAction action, const char *file, int rate)
+        : action(action), filename(file), rate(rate) {}
+ControlTransfer ProfileStatement::execute(EvalState &state, Program &pro) {
+    switch (action) {
+        case PROFILE_ON:
+            Sampler::stop();
+            Profiler::reset();
+            Profiler::setEnabled(true);
+            break;
+        case PROFILE_OFF:
+            Profiler::setEnabled(false);
+            Sampler::stop();
+            break;
+        case PROFILE_RESET:
+            Profiler::reset();
+            Sampler::reset();
+            break;
+        case PROFILE_CSV:
+            if (!Profiler::writeCsv(filename)) {
+                Output::writeLine("FILE ERROR");
+            }
+            break;
+        case PROFILE_SAMPLE:
+            Profiler::setEnabled(false);
+            if (!Sampler::start(rate)) {
+                Output::writeLine("PROFILE ERROR");
+            }
+            break;
+        case PROFILE_FOLDED:
+            if (!Sampler::writeFolded(filename)) {
+                Output::writeLine("FILE ERROR");
+            }
+            break;
+        case PROFILE_REPORT:
+            Profiler::report();
+            Sampler::report();
+            break;
+    }
+    return PROCEED;
+}
+StatementType ProfileStatement::getType() {
+    return PROFILE_STMT;
+}
+
+
+/*
+ * Implementation notes: parseStatement
+ * ------------------------------------
+ * Each statement is described once in STATEMENTS by its keyword, the
+ * function that parses its operands and the modes it is allowed in.
+ * Keywords are found with a perfect hash on the first and last letters
+ * and the length; the table is built at compile time and a
+ * static_assert rejects a keyword list on which the hash collides, so
+ * a lookup costs one table probe and one string comparison.  For IF,
+ * stopAt bounds the scanner at the comparison operator and then at
+ * THEN, so each side is parsed in place.  The parsers only report a
+ * malformed statement by returning nullptr; parseStatement prints the
+ * message, while tryParseStatement leaves that to its caller so that
+ * it can run on a thread other than the one that owns the output.
+ */
 
+typedef Statement *(*StatementParser)(TokenScanner &scanner, Arena &arena);
+
+struct StatementSyntax {
+    std::string_view keyword;
+    StatementParser parse;
+    int modes;
+};
+
+static Statement *syntaxError() {
+    return nullptr;
+}
+
+static bool isComparison(std::string_view token) {
+    return !token.empty() && (token[0] == '=' || token[0] == '<' || token[0] == '>');
+}
+
+static bool isThen(std::string_view token) {
+    return token == "THEN";
+}
+
+static Statement *parseRem(TokenScanner &scanner, Arena &arena) {
+    return new (arena) REMStatement();
+}
+
+static Statement *parseLet(TokenScanner &scanner, Arena &arena) {
+    if (!scanner.hasMoreTokens()) return syntaxError();
+    std::string variable = scanner.nextToken();
+    if (scanner.nextToken()[0] != '=' || !scanner.hasMoreTokens()) return syntaxError();
+    Expression *exp = parseExp(scanner, arena);
+    return new (arena) LetStatement(variable, exp);
+}
+
+static Statement *parsePrint(TokenScanner &scanner, Arena &arena) {
+    if (!scanner.hasMoreTokens()) return syntaxError();
+    Expression *exp = parseExp(scanner, arena);
+    return new (arena) PrintStatement(exp);
+}
+
+static Statement *parseInput(TokenScanner &scanner, Arena &arena) {
+    if (!scanner.hasMoreTokens()) return syntaxError();
+    std::string variable = scanner.nextToken();
+    if (scanner.hasMoreTokens()) return syntaxError();
+    return new (arena) InputStatement(variable);
+}
+
+static Statement *parseEnd(TokenScanner &scanner, Arena &arena) {
+    if (scanner.hasMoreTokens()) return syntaxError();
+    return new (arena) EndStatement();
+}
+
+static Statement *parseGoto(TokenScanner &scanner, Arena &arena) {
+    if (!scanner.hasMoreTokens()) return syntaxError();
+    std::string input = scanner.nextToken();
+    if (scanner.hasMoreTokens()) return syntaxError();
+    int value;
+    try {
+        value = std::stoi(input);
+    } catch (std::exception &e) {
+        return syntaxError();
+    }
+    return new (arena) GotoStatement(value);
+}
+
+static Statement *parseIf(TokenScanner &scanner, Arena &arena) {
+    if (!scanner.hasMoreTokens()) return syntaxError();
+    scanner.stopAt(isComparison);
+    Expression *lhs = parseExp(scanner, arena);
+    scanner.stopAt(nullptr);
+    std::string op = scanner.nextToken();
+    if (!isComparison(op)) return syntaxError();
+    scanner.stopAt(isThen);
+    Expression *rhs = parseExp(scanner, arena);
+    scanner.stopAt(nullptr);
+    if (scanner.nextToken() != "THEN") return syntaxError();
+    int target;
+    try {
+        target = std::stoi(scanner.nextToken());
+    } catch (std::exception &e) {
+        return syntaxError();
+    }
+    if (scanner.hasMoreTokens()) return syntaxError();
+    return new (arena) IfStatement(lhs, rhs, op[0], target);
+}
+
+template <typename T>
+static Statement *parseCommand(TokenScanner &scanner, Arena &arena) {
+    return new (arena) T();
+}
+
+static const char *readFilename(TokenScanner &scanner, Arena &arena) {
+    std::string_view filename = scanner.readRest();
+    while (!filename.empty() && isspace((unsigned char) filename.back())) {
+        filename.remove_suffix(1);
+    }
+    if (filename.empty()) return nullptr;
+    char *copy = static_cast<char *>(arena.allocate(filename.length() + 1, 1));
+    std::memcpy(copy, filename.data(), filename.length());
+    copy[filename.length()] = '\0';
+    return copy;
+}
+
+template <typename T>
+static Statement *parseFileCommand(TokenScanner &scanner, Arena &arena) {
+    const char *filename = readFilename(scanner, arena);
+    if (filename == nullptr) return syntaxError();
+    return new (arena) T(filename);
+}
+
+static const int DEFAULT_SAMPLE_RATE = 1000;
+static const int MAX_SAMPLE_RATE = 100000;
+
+static Statement *parseProfile(TokenScanner &scanner, Arena &arena) {
+    if (!scanner.hasMoreTokens()) return new (arena) ProfileStatement(PROFILE_REPORT, nullptr);
+    std::string option = scanner.nextToken();
+    if (option == "CSV") {
+        const char *filename = readFilename(scanner, arena);
+        if (filename == nullptr) return syntaxError();
+        return new (arena) ProfileStatement(PROFILE_CSV, filename);
+    }
+    if (option == "FOLDED") {
+        const char *filename = readFilename(scanner, arena);
+        if (filename == nullptr) return syntaxError();
+        return new (arena) ProfileStatement(PROFILE_FOLDED, filename);
+    }
+    if (option == "SAMPLE") {
+        int rate = DEFAULT_SAMPLE_RATE;
+        if (scanner.hasMoreTokens()) {
+            std::string token = scanner.nextToken();
+            const char *end = token.data() + token.length();
+            if (scanner.getTokenType(token) != NUMBER || std::from_chars(token.data(), end, rate).ec != std::errc() ||
+                rate <= 0 || rate > MAX_SAMPLE_RATE) {
+                return syntaxError();
+            }
+        }
+        if (scanner.hasMoreTokens()) return syntaxError();
+        return new (arena) ProfileStatement(PROFILE_SAMPLE, nullptr, rate);
+    }
+    if (scanner.hasMoreTokens()) return syntaxError();
+    if (option == "ON") return new (arena) ProfileStatement(PROFILE_ON, nullptr);
+    if (option == "OFF") return new (arena) ProfileStatement(PROFILE_OFF, nullptr);
+    if (option == "RESET") return new (arena) ProfileStatement(PROFILE_RESET, nullptr);
+    return syntaxError();
+}
+
+static constexpr StatementSyntax STATEMENTS[] = {
+    {"REM",   parseRem,                     IMMEDIATE_MODE | PROGRAM_MODE},
+    {"LET",   parseLet,                     IMMEDIATE_MODE | PROGRAM_MODE},
+    {"PRINT", parsePrint,                   IMMEDIATE_MODE | PROGRAM_MODE},
+    {"INPUT", parseInput,                   IMMEDIATE_MODE | PROGRAM_MODE},
+    {"END",   parseEnd,                     IMMEDIATE_MODE | PROGRAM_MODE},
+    {"GOTO",  parseGoto,                    PROGRAM_MODE},
+    {"IF",    parseIf,                      PROGRAM_MODE},
+    {"RUN",   parseCommand<RunStatement>,   IMMEDIATE_MODE},
+    {"LIST",  parseCommand<ListStatement>,  IMMEDIATE_MODE},
+    {"CLEAR", parseCommand<ClearStatement>, IMMEDIATE_MODE},
+    {"QUIT",  parseCommand<QuitStatement>,  IMMEDIATE_MODE},
+    {"HELP",  parseCommand<HelpStatement>,  IMMEDIATE_MODE},
+    {"SAVE",  parseFileCommand<SaveStatement>, IMMEDIATE_MODE},
+    {"LOAD",  parseFileCommand<LoadStatement>, IMMEDIATE_MODE},
+    {"PROFILE", parseProfile,               IMMEDIATE_MODE},
+};
+
+static constexpr int STATEMENT_COUNT = sizeof(STATEMENTS) / sizeof(STATEMENTS[0]);
+static constexpr int KEYWORD_BUCKETS = 32;
+
+static constexpr int keywordHash(std::string_view word) {
+    return (word[0] * 4 + word[word.size() - 1] * 3 + (int) word.size()) & (KEYWORD_BUCKETS - 1);
+}
+
+struct KeywordTable {
+    signed char index[KEYWORD_BUCKETS];
+};
+
+static constexpr KeywordTable buildKeywordTable() {
+    KeywordTable table = {};
+    for (int i = 0; i < KEYWORD_BUCKETS; i++) table.index[i] = -1;
+    for (int i = 0; i < STATEMENT_COUNT; i++) {
+        table.index[keywordHash(STATEMENTS[i].keyword)] = i;
+    }
+    return table;
+}
+
+static constexpr bool isPerfectHash(const KeywordTable &table) {
+    for (int i = 0; i < STATEMENT_COUNT; i++) {
+        if (table.index[keywordHash(STATEMENTS[i].keyword)] != i) return false;
+    }
+    return true;
+}
+
+static constexpr KeywordTable KEYWORDS = buildKeywordTable();
+static_assert(isPerfectHash(KEYWORDS), "keywordHash collides on the statement keywords");
+
+Statement *parseStatement(std::string_view keyword, TokenScanner &scanner, Arena &arena, StatementMode mode) {
+    Statement *stmt = tryParseStatement(keyword, scanner, arena, mode);
+    if (stmt == nullptr) Output::writeLine("SYNTAX ERROR");
+    return stmt;
+}
+
+Statement *tryParseStatement(std::string_view keyword, TokenScanner &scanner, Arena &arena, StatementMode mode) {
+    if (keyword.empty()) return syntaxError();
+    int i = KEYWORDS.index[keywordHash(keyword)];
+    if (i < 0 || STATEMENTS[i].keyword != keyword || !(STATEMENTS[i].modes & mode)) {
+        return syntaxError();
+    }
+    return STATEMENTS[i].parse(scanner, arena);
+}
@@ -12,7 +12,6 @@
 #ifndef _statement_h
 #define _statement_h
 
-#include "program.hpp"
 #include <string>
 #include <sstream>
 #include "evalstate.hpp"
@@ -23,6 +22,33 @@
 #include "Utils/strlib.hpp"
 
 class Program;
+
+/*
+ * Type: StatementType
+ * -------------------
+ * This enumerated type tags each concrete Statement subclass so that
+ * the interpreter can dispatch on the kind of a statement without
+ * inspecting its source text or using dynamic_cast.
+ */
+
+enum StatementType {
+    REM_STMT, LET_STMT, PRINT_STMT, INPUT_STMT, END_STMT, GOTO_STMT, IF_STMT,
+    RUN_STMT, LIST_STMT, QUIT_STMT, CLEAR_STMT, HELP_STMT, SAVE_STMT, LOAD_STMT,
+    PROFILE_STMT
+};
+
+/*
+ * Type: ControlTransfer
+ * ---------------------
+ * This enumerated type is the result of executing a statement.  It
+ * tells the interpreter whether to proceed to the next line, to jump
+ * to the target of the statement, or to stop the program.
+ */
+
+enum ControlTransfer {
+    PROCEED, JUMP, STOP
+};
+
 /*
  * Class: Statement
  * ----------------
@@ -59,16 +85,27 @@ public:
 
 /*
  * Method: execute
- * Usage: stmt->execute(state);
- * ----------------------------
+ * Usage: ControlTransfer next = stmt->execute(state, program);
+ * ------------------------------------------------------------
  * This method executes a BASIC statement.  Each of the subclasses
  * defines its own execute method that implements the necessary
  * operations.  As was true for the expression evaluator, this
  * method takes an EvalState object for looking up variables or
- * controlling the operation of the interpreter.
+ * controlling the operation of the interpreter.  The result tells
+ * the caller where control goes next: GOTO and a satisfied IF
+ * return JUMP, END returns STOP and every other statement PROCEED.
  */
 
-    virtual void execute(EvalState &state, Program &pro) = 0;
+    virtual ControlTransfer execute(EvalState &state, Program &pro) = 0;
+
+/*
+ * Method: getType
+ * Usage: StatementType type = stmt->getType();
+ * --------------------------------------------
+ * Returns the kind of the statement as one of the StatementType tags.
+ */
+
+    virtual StatementType getType() = 0;
 
 };
 
@@ -78,48 +115,57 @@ public:
  * definitions for the individual statement forms.  Each of
  * those subclasses must define a constructor that parses a
  * statement from a scanner and a method called execute,
- * which executes that statement.  If the private data for
- * a subclass includes data allocated on the heap (such as
- * an Expression object), the class implementation must also
- * specify its own destructor method to free that memory.
+ * which executes that statement.  Statements are allocated
+ * in an Arena together with the Expression objects they refer
+ * to, and the arena frees them all at once; subclasses
+ * therefore hold no storage that needs a destructor.
  */
 class REMStatement : public Statement {
     public:
     REMStatement();
-    void execute(EvalState &state, Program &pro);
+    ControlTransfer execute(EvalState &state, Program &pro);
+    StatementType getType();
 };
 
 class LetStatement : public Statement {
     public:
     LetStatement(std::string variable, Expression *exp);
-    ~LetStatement();
-    void execute(EvalState &state, Program &pro);
+    ControlTransfer execute(EvalState &state, Program &pro);
+    StatementType getType();
+    int getSlot();
+    bool isIllegal();
+    Expression *getExp();
     private:
-    std::string var;
+    int slot;
+    bool illegal;
     Expression *exp;
 };
 
 class PrintStatement : public Statement {
     public:
     PrintStatement(Expression *exp);
-    ~PrintStatement();
-    void execute(EvalState &state, Program &pro);
+    ControlTransfer execute(EvalState &state, Program &pro);
+    StatementType getType();
+    Expression *getExp();
     private:
     Expression *exp;
 };
 
 class InputStatement : public Statement {
     private:
-    std::string variable;
+    int slot;
     public:
     InputStatement(std::string str);
-    void execute(EvalState &state, Program &pro);
+    ControlTransfer execute(EvalState &state, Program &pro);
+    StatementType getType();
+    int getSlot();
 };
 
 class EndStatement : public Statement {
     public:
     EndStatement();
-    void execute(EvalState &state, Program &pro);
+    ControlTransfer execute(EvalState &state, Program &pro);
+    StatementType getType();
 };
 
 class GotoStatement : public Statement {
@@ -127,7 +173,8 @@ class GotoStatement : public Statement {
     int linetarget;
     public:
     GotoStatement(int line);
-    void execute(EvalState &state, Program &pro);
+    ControlTransfer execute(EvalState &state, Program &pro);
+    StatementType getType();
     int getlinetarget();
 };
 
@@ -139,41 +186,131 @@ class IfStatement : public Statement {
     int target;
     public:
     IfStatement(Expression *left, Expression *right, char s, int targetline);
-    ~IfStatement();
-    void execute(EvalState &state, Program &pro);
+    ControlTransfer execute(EvalState &state, Program &pro);
+    StatementType getType();
     bool condition(EvalState &state, Program &pro);
     int get_target_line();
+    Expression *getLHS();
+    Expression *getRHS();
+    char getOp();
 };
 
 class RunStatement : public Statement {
     public:
     RunStatement();
-    void execute(EvalState &state, Program &pro);
+    ControlTransfer execute(EvalState &state, Program &pro);
+    StatementType getType();
 };
 
 class ListStatement : public Statement {
     public:
     ListStatement();
-    void execute(EvalState &state, Program &pro);
+    ControlTransfer execute(EvalState &state, Program &pro);
+    StatementType getType();
 };
 
 class QuitStatement : public Statement {
     public:
     QuitStatement();
-    void execute(EvalState &state, Program &pro);
+    ControlTransfer execute(EvalState &state, Program &pro);
+    StatementType getType();
 };
 
 class ClearStatement : public Statement {
     public:
     ClearStatement();
-    void execute(EvalState &state, Program &pro);
+    ControlTransfer execute(EvalState &state, Program &pro);
+    StatementType getType();
 };
 
 class HelpStatement : public Statement {
     public:
     HelpStatement();
-    void execute(EvalState &state, Program &pro);
+    ControlTransfer execute(EvalState &state, Program &pro);
+    StatementType getType();
+};
+
+class SaveStatement : public Statement {
+    private:
+    const char *filename;
+    public:
+    SaveStatement(const char *file);
+    ControlTransfer execute(EvalState &state, Program &pro);
+    StatementType getType();
+};
+
+class LoadStatement : public Statement {
+    private:
+    const char *filename;
+    public:
+    LoadStatement(const char *file);
+    ControlTransfer execute(EvalState &state, Program &pro);
+    StatementType getType();
 };
 
+/*
+ * Type: ProfileAction
+ * -------------------
+ * The forms of the PROFILE command: PROFILE ON (clear the figures and
+ * start collecting), PROFILE OFF, PROFILE RESET, PROFILE CSV file,
+ * PROFILE SAMPLE [rate] (start the sampler, by default at 1000 samples
+ * per second), PROFILE FOLDED file (write the samples as folded stacks)
+ * and a bare PROFILE, which prints the report.  Counting and sampling
+ * exclude each other; starting one stops the other.
+ */
+
+enum ProfileAction {
+    PROFILE_ON, PROFILE_OFF, PROFILE_RESET, PROFILE_CSV, PROFILE_SAMPLE, PROFILE_FOLDED, PROFILE_REPORT
+};
+
+class ProfileStatement : public Statement {
+    private:
+    ProfileAction action;
+    const char *filename;
+    int rate;
+    public:
+    ProfileStatement(ProfileAction action, const char *file, int rate = 0);
+    ControlTransfer execute(EvalState &state, Program &pro);
+    StatementType getType();
+};
+
+/*
+ * Type: StatementMode
+ * -------------------
+ * The contexts a statement may appear in: typed directly at the prompt
+ * (IMMEDIATE_MODE) or stored as a numbered program line (PROGRAM_MODE).
+ */
+
+enum StatementMode {
+    IMMEDIATE_MODE = 1, PROGRAM_MODE = 2
+};
+
+/*
+ * Function: parseStatement
+ * Usage: Statement *stmt = parseStatement(keyword, scanner, arena, mode);
+ * -----------------------------------------------------------------------
+ * Parses the rest of a statement that begins with keyword, reading its
+ * operands from the scanner, and returns it allocated in the arena.
+ * The keyword is looked up in one statement table shared by both modes.
+ * If the keyword is unknown, is not allowed in the mode, or its operands
+ * are malformed, parseStatement prints SYNTAX ERROR and returns nullptr;
+ * errors inside an expression are thrown by parseExp as usual.
+ */
+
+Statement *parseStatement(std::string_view keyword, TokenScanner &scanner, Arena &arena, StatementMode mode);
+
+/*
+ * Function: tryParseStatement
+ * Usage: Statement *stmt = tryParseStatement(keyword, scanner, arena, mode);
+ * --------------------------------------------------------------------------
+ * Parses a statement exactly like parseStatement, but returns nullptr
+ * for a malformed statement without printing anything.  It touches no
+ * shared state other than the slot table, so it may be called from
+ * several threads at once as long as each uses its own scanner and
+ * arena.
+ */
+
+Statement *tryParseStatement(std::string_view keyword, TokenScanner &scanner, Arena &arena, StatementMode mode);
+
 
 #endif
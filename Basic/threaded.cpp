@@ -0,0 +1,287 @@
+/*
+ * File: threaded.cpp
+ * ------------------
+ * This file implements the lowering pass and the direct-threaded
+ * execution engine.
+ */
+
+#include <algorithm>
+#include "threaded.hpp"
+#include "output.hpp"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define THREADED_GOTO 1
+#else
+#define THREADED_GOTO 0
+#endif
+
+/*
+ * Implementation notes: lowerProgram
+ * ----------------------------------
+ * Each line is lowered in order and the index of its first operation
+ * is recorded, so that jumps can be patched once every line has been
+ * placed.  A REM line emits nothing and therefore shares its index with
+ * the next line, which is where a jump to it should land.  Expressions
+ * that are not in postfix form are evaluated through L_EVAL.
+ */
+
+static int appendExp(LoweredProgram &lowered, Expression *exp) {
+    if (exp->getType() != POSTFIX) {
+        lowered.ops.push_back({L_EVAL, (int) lowered.exprs.size()});
+        lowered.exprs.push_back(exp);
+        return 1;
+    }
+    PostfixExp *postfix = (PostfixExp *) exp;
+    const PostfixInstr *code = postfix->getCode();
+    for (int i = 0; i < postfix->getLength(); i++) {
+        lowered.ops.push_back({code[i].code, code[i].operand});
+    }
+    return postfix->getDepth();
+}
+
+void lowerProgram(Program &program, LoweredProgram &lowered) {
+    const std::vector<Instruction> &code = program.compile();
+    std::vector<int> start(code.size());
+    std::vector<std::pair<int, int>> jumps;
+    lowered.ops.clear();
+    lowered.calls.clear();
+    lowered.exprs.clear();
+    lowered.depth = 1;
+    for (size_t i = 0; i < code.size(); i++) {
+        const Instruction &ins = code[i];
+        start[i] = lowered.ops.size();
+        switch (ins.type) {
+            case REM_STMT:
+                break;
+            case LET_STMT: {
+                LetStatement *sta = (LetStatement *) ins.stmt;
+                if (sta->isIllegal()) {
+                    lowered.ops.push_back({L_LET_ILLEGAL, 0});
+                    break;
+                }
+                lowered.depth = std::max(lowered.depth, appendExp(lowered, sta->getExp()));
+                lowered.ops.push_back({L_LET, sta->getSlot()});
+                break;
+            }
+            case PRINT_STMT:
+                lowered.depth = std::max(lowered.depth, appendExp(lowered, ((PrintStatement *) ins.stmt)->getExp()));
+                lowered.ops.push_back({L_PRINT, 0});
+                break;
+            case END_STMT:
+                lowered.ops.push_back({L_HALT, 0});
+                break;
+            case GOTO_STMT:
+                if (ins.target == -1) {
+                    lowered.ops.push_back({L_LINE_ERROR, 0});
+                    lowered.ops.push_back({L_HALT, 0});
+                    break;
+                }
+                jumps.emplace_back(lowered.ops.size(), ins.target);
+                lowered.ops.push_back({L_GOTO, 0});
+                break;
+            case IF_STMT: {
+                IfStatement *sta = (IfStatement *) ins.stmt;
+                if (ins.target == -1) {
+                    lowered.ops.push_back({L_LINE_ERROR, 0});
+                }
+                int left = appendExp(lowered, sta->getLHS());
+                int right = appendExp(lowered, sta->getRHS());
+                lowered.depth = std::max(lowered.depth, std::max(left, right + 1));
+                int op = sta->getOp() == '=' ? L_IF_EQ : sta->getOp() == '<' ? L_IF_LT : L_IF_GT;
+                jumps.emplace_back(lowered.ops.size(), ins.target);
+                lowered.ops.push_back({op, 0});
+                break;
+            }
+            default:
+                lowered.ops.push_back({L_CALL, (int) lowered.calls.size()});
+                lowered.calls.push_back(ins.stmt);
+                break;
+        }
+    }
+    int halt = lowered.ops.size();
+    lowered.ops.push_back({L_HALT, 0});
+    for (const std::pair<int, int> &jump : jumps) {
+        lowered.ops[jump.first].operand = jump.second == -1 ? halt : start[jump.second];
+    }
+}
+
+/*
+ * Implementation notes: runThreaded
+ * ---------------------------------
+ * The OP, NEXT and JUMP macros let one body serve both dispatch
+ * methods.  With computed gotos every operation carries the address of
+ * its handler, so each handler ends in its own indirect jump, which
+ * the branch predictor can track separately.  The value stack is
+ * allocated once per run and is empty at the start of every statement.
+ */
+
+static void undefinedVariable(int &value) {
+    Output::writeLine("VARIABLE NOT DEFINED");
+    value = 114514;
+}
+
+static void divideByZero(int &value) {
+    Output::writeLine("DIVIDE BY ZERO");
+    value = 114514;
+}
+
+#define READ_VAR(slot, value)                            \
+    if (state.isDefined(slot)) value = state.getValue(slot); \
+    else undefinedVariable(value)
+
+struct ThreadedOp {
+    const void *handler;
+    int operand;
+};
+
+void runThreaded(EvalState &state, Program &program) {
+    LoweredProgram lowered;
+    lowerProgram(program, lowered);
+    std::vector<int> storage(lowered.depth + 1);
+    int *stack = storage.data();
+    int sp = 0;
+    int right;
+
+#if THREADED_GOTO
+    static const void *const handlers[] = {
+        &&do_const, &&do_var,
+        &&do_add, &&do_sub, &&do_mul, &&do_div,
+        &&do_add_const, &&do_sub_const, &&do_mul_const, &&do_div_const,
+        &&do_add_var, &&do_sub_var, &&do_mul_var, &&do_div_var,
+        &&do_assign, &&do_error,
+        &&do_eval, &&do_let, &&do_let_illegal, &&do_print, &&do_goto,
+        &&do_if_eq, &&do_if_lt, &&do_if_gt, &&do_line_error, &&do_call, &&do_halt
+    };
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == L_HALT + 1, "handler table out of date");
+    std::vector<ThreadedOp> ops(lowered.ops.size());
+    for (size_t i = 0; i < ops.size(); i++) {
+        ops[i] = {handlers[lowered.ops[i].code], lowered.ops[i].operand};
+    }
+    const ThreadedOp *base = ops.data();
+    const ThreadedOp *ip = base;
+#define OP(label, code) label:
+#define NEXT() goto *(++ip)->handler
+#define JUMP(target) ip = base + (target); goto *ip->handler
+    goto *ip->handler;
+#else
+    const LoweredOp *base = lowered.ops.data();
+    const LoweredOp *ip = base;
+#define OP(label, code) case code:
+#define NEXT() ip++; goto dispatch
+#define JUMP(target) ip = base + (target); goto dispatch
+dispatch:
+    switch (ip->code) {
+#endif
+
+    OP(do_const, PF_CONST)
+        stack[sp++] = ip->operand;
+        NEXT();
+    OP(do_var, PF_VAR)
+        READ_VAR(ip->operand, stack[sp]);
+        sp++;
+        NEXT();
+    OP(do_add, PF_ADD)
+        sp--;
+        stack[sp - 1] = stack[sp - 1] + stack[sp];
+        NEXT();
+    OP(do_sub, PF_SUB)
+        sp--;
+        stack[sp - 1] = stack[sp - 1] - stack[sp];
+        NEXT();
+    OP(do_mul, PF_MUL)
+        sp--;
+        stack[sp - 1] = stack[sp - 1] * stack[sp];
+        NEXT();
+    OP(do_div, PF_DIV)
+        sp--;
+        if (stack[sp] == 0) divideByZero(stack[sp - 1]);
+        else stack[sp - 1] = stack[sp - 1] / stack[sp];
+        NEXT();
+    OP(do_add_const, PF_ADD_CONST)
+        stack[sp - 1] = stack[sp - 1] + ip->operand;
+        NEXT();
+    OP(do_sub_const, PF_SUB_CONST)
+        stack[sp - 1] = stack[sp - 1] - ip->operand;
+        NEXT();
+    OP(do_mul_const, PF_MUL_CONST)
+        stack[sp - 1] = stack[sp - 1] * ip->operand;
+        NEXT();
+    OP(do_div_const, PF_DIV_CONST)
+        if (ip->operand == 0) divideByZero(stack[sp - 1]);
+        else stack[sp - 1] = stack[sp - 1] / ip->operand;
+        NEXT();
+    OP(do_add_var, PF_ADD_VAR)
+        READ_VAR(ip->operand, right);
+        stack[sp - 1] = stack[sp - 1] + right;
+        NEXT();
+    OP(do_sub_var, PF_SUB_VAR)
+        READ_VAR(ip->operand, right);
+        stack[sp - 1] = stack[sp - 1] - right;
+        NEXT();
+    OP(do_mul_var, PF_MUL_VAR)
+        READ_VAR(ip->operand, right);
+        stack[sp - 1] = stack[sp - 1] * right;
+        NEXT();
+    OP(do_div_var, PF_DIV_VAR)
+        READ_VAR(ip->operand, right);
+        if (right == 0) divideByZero(stack[sp - 1]);
+        else stack[sp - 1] = stack[sp - 1] / right;
+        NEXT();
+    OP(do_assign, PF_ASSIGN)
+        state.setValue(ip->operand, stack[sp - 1]);
+        NEXT();
+    OP(do_error, PF_ERROR)
+        error(POSTFIX_ERRORS[ip->operand]);
+    OP(do_eval, L_EVAL)
+        stack[sp++] = lowered.exprs[ip->operand]->eval(state);
+        NEXT();
+    OP(do_let, L_LET)
+        state.setValue(ip->operand, stack[--sp]);
+        NEXT();
+    OP(do_let_illegal, L_LET_ILLEGAL)
+        Output::writeLine("SYNTAX ERROR");
+        NEXT();
+    OP(do_print, L_PRINT)
+        sp--;
+        if (stack[sp] != 114514) {
+            Output::writeLine(stack[sp]);
+        }
+        NEXT();
+    OP(do_goto, L_GOTO)
+        JUMP(ip->operand);
+    OP(do_if_eq, L_IF_EQ)
+        sp -= 2;
+        if (stack[sp] == stack[sp + 1]) {
+            JUMP(ip->operand);
+        }
+        NEXT();
+    OP(do_if_lt, L_IF_LT)
+        sp -= 2;
+        if (stack[sp] < stack[sp + 1]) {
+            JUMP(ip->operand);
+        }
+        NEXT();
+    OP(do_if_gt, L_IF_GT)
+        sp -= 2;
+        if (stack[sp] > stack[sp + 1]) {
+            JUMP(ip->operand);
+        }
+        NEXT();
+    OP(do_line_error, L_LINE_ERROR)
+        Output::writeLine("LINE NUMBER ERROR");
+        NEXT();
+    OP(do_call, L_CALL)
+        if (lowered.calls[ip->operand]->execute(state, program) == STOP) {
+            return;
+        }
+        NEXT();
+    OP(do_halt, L_HALT)
+        return;
+
+#if !THREADED_GOTO
+    }
+#endif
+#undef OP
+#undef NEXT
+#undef JUMP
+}
@@ -0,0 +1,94 @@
+/*
+ * File: threaded.h
+ * ----------------
+ * This interface exports the direct-threaded execution engine, which
+ * runs a program after lowering it into one flat array of operations
+ * covering both statements and expressions.
+ */
+
+#ifndef _threaded_h
+#define _threaded_h
+
+#include <vector>
+#include "evalstate.hpp"
+#include "exp.hpp"
+#include "program.hpp"
+#include "statement.hpp"
+
+/*
+ * Type: LoweredCode
+ * -----------------
+ * This enumerated type defines the operations of a lowered program.
+ * The expression operations keep the values of PostfixCode, so the
+ * postfix array of an expression is copied unchanged.  The statement
+ * operations that follow consume the values left on the stack:
+ *
+ *   L_EVAL        -- pushes the value of exprs[operand]
+ *   L_LET         -- pops a value into the variable slot operand
+ *   L_LET_ILLEGAL -- reports the SYNTAX ERROR of LET LET = ...
+ *   L_PRINT       -- pops a value and prints it
+ *   L_GOTO        -- continues at the operation index operand
+ *   L_IF_EQ/LT/GT -- pops two values and jumps to operand if the
+ *                    comparison holds
+ *   L_LINE_ERROR  -- reports LINE NUMBER ERROR
+ *   L_CALL        -- executes calls[operand] and stops on STOP
+ *   L_HALT        -- ends the program
+ */
+
+enum LoweredCode {
+    L_EVAL = PF_ERROR + 1, L_LET, L_LET_ILLEGAL, L_PRINT, L_GOTO,
+    L_IF_EQ, L_IF_LT, L_IF_GT, L_LINE_ERROR, L_CALL, L_HALT
+};
+
+/*
+ * Type: LoweredOp
+ * ---------------
+ * One operation of a lowered program with its operand.  The code is
+ * either a PostfixCode or a LoweredCode.
+ */
+
+struct LoweredOp {
+    int code;
+    int operand;
+};
+
+/*
+ * Type: LoweredProgram
+ * --------------------
+ * The result of lowerProgram.  Jump operands are indices into ops,
+ * whose last operation is always L_HALT.  The depth field is the
+ * largest number of values any statement keeps on the stack.
+ */
+
+struct LoweredProgram {
+    std::vector<LoweredOp> ops;
+    std::vector<Statement *> calls;
+    std::vector<Expression *> exprs;
+    int depth;
+};
+
+/*
+ * Function: lowerProgram
+ * Usage: lowerProgram(program, lowered);
+ * --------------------------------------
+ * Compiles and links the program and lowers it into a flat array of
+ * operations.  Jumps are resolved to operation indices; a GOTO or IF
+ * whose target does not exist reports LINE NUMBER ERROR at the same
+ * point as the tree-walking interpreter and jumps to the final L_HALT.
+ */
+
+void lowerProgram(Program &program, LoweredProgram &lowered);
+
+/*
+ * Function: runThreaded
+ * Usage: runThreaded(state, program);
+ * -----------------------------------
+ * Runs the program on the direct-threaded engine.  With GCC or Clang
+ * each operation jumps straight to the handler of the next one through
+ * a computed goto; other compilers fall back to a switch.  The output
+ * is identical to RunStatement with the TREE_WALKER engine.
+ */
+
+void runThreaded(EvalState &state, Program &program);
+
+#endif
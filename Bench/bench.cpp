@@ -0,0 +1,376 @@
+/*
+ * File: bench.cpp
+ * ---------------
+ * This file implements basic_bench, a set of microbenchmarks for the
+ * components of the interpreter: the token scanner, the expression
+ * parser, expression evaluation, the variable table, adding program
+ * lines and the RUN loop under each engine.
+ *
+ * Every benchmark runs a fixed number of iterations after a warmup of
+ * a tenth of that number, and reports the time and the number of heap
+ * allocations per operation.  The allocations are counted by replacing
+ * the global operator new in this program.
+ *
+ * Usage: basic_bench [--format=text|csv|json] [--filter=text] [--scale=n]
+ *
+ * --filter runs only the benchmarks whose name contains the text, and
+ * --scale multiplies every iteration count, so that --scale=10 gives
+ * steadier figures and --scale=0 merely checks that everything runs.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include "../Basic/arena.hpp"
+#include "../Basic/evalstate.hpp"
+#include "../Basic/exp.hpp"
+#include "../Basic/parser.hpp"
+#include "../Basic/program.hpp"
+#include "../Basic/statement.hpp"
+#include "../Basic/Utils/tokenScanner.hpp"
+
+/*
+ * Allocation counting
+ * -------------------
+ * The plain and the std::align_val_t forms of operator new are
+ * replaced, together with the unsized and sized operator delete that
+ * match each; by default the array and nothrow forms call these.  The
+ * counters are atomic because a large loadSource parses on worker
+ * threads.  Memory is returned through a function the compiler does
+ * not inline, since GCC otherwise sees free applied to a pointer from
+ * operator new and warns with -Wmismatched-new-delete.
+ */
+
+static std::atomic<uint64_t> allocations(0);
+static std::atomic<uint64_t> allocatedBytes(0);
+
+static void *countedAlloc(std::size_t size, std::size_t alignment) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    void *p = nullptr;
+    if (alignment <= alignof(std::max_align_t)) {
+        p = std::malloc(size);
+    } else if (posix_memalign(&p, alignment, size) != 0) {
+        p = nullptr;
+    }
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+__attribute__((noinline)) static void countedFree(void *p) noexcept {
+    std::free(p);
+}
+
+void *operator new(std::size_t size) {
+    return countedAlloc(size, 0);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    return countedAlloc(size, std::size_t(alignment));
+}
+
+void operator delete(void *p) noexcept {
+    countedFree(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    countedFree(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept {
+    countedFree(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+    countedFree(p);
+}
+
+/*
+ * Type: Result
+ * ------------
+ * The figures reported for one benchmark.  An operation is the unit
+ * named in the benchmark's description: one token, one parse, one
+ * statement executed and so on.
+ */
+
+struct Result {
+    std::string name;
+    uint64_t operations;
+    double nsPerOp;
+    double allocsPerOp;
+    double bytesPerOp;
+};
+
+/*
+ * Type: Benchmark
+ * ---------------
+ * A benchmark is a body that performs opsPerIteration operations each
+ * time it is called, and the number of iterations to time.
+ */
+
+struct Benchmark {
+    const char *name;
+    uint64_t iterations;
+    uint64_t opsPerIteration;
+    std::function<void()> body;
+};
+
+/* Keeps results alive so that the compiler cannot drop the work */
+
+static volatile int sink;
+
+/*
+ * Function: measure
+ * Usage: Result result = measure(benchmark, scale);
+ * -------------------------------------------------
+ * Runs the warmup, then times the scaled number of iterations with the
+ * allocation counters reset.
+ */
+
+static Result measure(const Benchmark &bench, double scale) {
+    uint64_t iterations = std::max<uint64_t>(1, uint64_t(bench.iterations * scale));
+    for (uint64_t i = 0; i < std::max<uint64_t>(1, iterations / 10); i++) {
+        bench.body();
+    }
+    allocations.store(0);
+    allocatedBytes.store(0);
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+        bench.body();
+    }
+    auto finish = std::chrono::steady_clock::now();
+    double ops = double(iterations * bench.opsPerIteration);
+    Result result;
+    result.name = bench.name;
+    result.operations = iterations * bench.opsPerIteration;
+    result.nsPerOp = std::chrono::duration<double, std::nano>(finish - start).count() / ops;
+    result.allocsPerOp = allocations.load() / ops;
+    result.bytesPerOp = allocatedBytes.load() / ops;
+    return result;
+}
+
+/*
+ * Function: repeat
+ * Usage: std::string text = repeat(piece, count, separator);
+ * ----------------------------------------------------------
+ * Joins count copies of piece with the separator.
+ */
+
+static std::string repeat(const std::string &piece, int count, const std::string &separator) {
+    std::string text;
+    for (int i = 0; i < count; i++) {
+        if (i > 0) text += separator;
+        text += piece;
+    }
+    return text;
+}
+
+/*
+ * Function: countTokens
+ * Usage: int n = countTokens(text);
+ * ---------------------------------
+ * Returns the number of tokens the interpreter's scanner finds in the
+ * text.
+ */
+
+static int countTokens(const std::string &text) {
+    TokenScanner scanner;
+    scanner.ignoreWhitespace();
+    scanner.scanNumbers();
+    scanner.setInputView(text);
+    int count = 0;
+    while (scanner.hasMoreTokens()) {
+        scanner.nextToken();
+        count++;
+    }
+    return count;
+}
+
+/*
+ * Function: parseBench
+ * Usage: Benchmark bench = parseBench(name, text, iterations);
+ * ------------------------------------------------------------
+ * Returns a benchmark that parses the expression text into a fresh
+ * arena, the way the interpreter parses one line.
+ */
+
+static Benchmark parseBench(const char *name, const std::string &text, uint64_t iterations) {
+    return {name, iterations, 1, [text]() {
+        Arena arena;
+        TokenScanner scanner;
+        scanner.ignoreWhitespace();
+        scanner.scanNumbers();
+        scanner.setInputView(text);
+        sink = parseExp(scanner, arena)->getType();
+    }};
+}
+
+/*
+ * Function: runBench
+ * Usage: Benchmark bench = runBench(name, engine, loops);
+ * -------------------------------------------------------
+ * Returns a benchmark that executes RUN on a counting loop of the
+ * given length with the given engine.  The loop body is three
+ * statements, each counted as an operation; the program is compiled
+ * once during the warmup, as it is for repeated RUN commands.
+ */
+
+static Benchmark runBench(const char *name, ExecutionEngine engine, int loops) {
+    auto program = std::make_shared<Program>();
+    auto state = std::make_shared<EvalState>();
+    state->setEngine(engine);
+    program->addSourceLine(10, "LET I = 0 ");
+    program->addSourceLine(20, "LET S = 0 ");
+    program->addSourceLine(30, "LET S = S + I * 3 - I / 7 ");
+    program->addSourceLine(40, "LET I = I + 1 ");
+    program->addSourceLine(50, "IF I < " + std::to_string(loops) + " THEN 30 ");
+    return {name, 1, 3 * uint64_t(loops), [program, state]() {
+        RunStatement().execute(*state, *program);
+        sink = state->getValue("S");
+    }};
+}
+
+/*
+ * Function: createBenchmarks
+ * Usage: std::vector<Benchmark> benchmarks = createBenchmarks();
+ * --------------------------------------------------------------
+ * Builds the list of benchmarks together with their inputs.
+ */
+
+static std::vector<Benchmark> createBenchmarks() {
+    std::vector<Benchmark> benchmarks;
+
+    std::string line = "LET RESULT = (ALPHA + 12345) * BETA - GAMMA / 7 ";
+    int lineTokens = countTokens(line);
+    benchmarks.push_back({"scanner/nextToken", 200000, uint64_t(lineTokens), [line]() {
+        TokenScanner scanner;
+        scanner.ignoreWhitespace();
+        scanner.scanNumbers();
+        scanner.setInputView(line);
+        while (scanner.hasMoreTokens()) {
+            sink = scanner.nextToken().length();
+        }
+    }});
+
+    benchmarks.push_back(parseBench("parser/parseExp/simple", "(ALPHA + 12345) * BETA - GAMMA / 7", 100000));
+    benchmarks.push_back(parseBench("parser/parseExp/deep",
+                                    repeat("(", 64, "") + "A" + repeat(" + 1)", 64, ""), 10000));
+    benchmarks.push_back(parseBench("parser/parseExp/wide", repeat("A * B", 256, " + "), 2000));
+
+    auto state = std::make_shared<EvalState>();
+    state->setValue("ALPHA", 3);
+    state->setValue("BETA", 5);
+    state->setValue("GAMMA", 700);
+    auto arena = std::make_shared<Arena>();
+    TokenScanner scanner;
+    scanner.ignoreWhitespace();
+    scanner.scanNumbers();
+    scanner.setInput("(ALPHA + 12345) * BETA - GAMMA / 7");
+    Expression *exp = parseExp(scanner, *arena);
+    benchmarks.push_back({"exp/eval", 2000000, 1, [state, arena, exp]() {
+        sink = exp->eval(*state);
+    }});
+
+    std::string name = "ALPHA";
+    benchmarks.push_back({"evalstate/setValue/name", 2000000, 1, [state, name]() {
+        state->setValue(name, sink);
+    }});
+    benchmarks.push_back({"evalstate/getValue/name", 2000000, 1, [state, name]() {
+        sink = state->getValue(name);
+    }});
+    int slot = EvalState::getSlot("ALPHA");
+    benchmarks.push_back({"evalstate/setValue/slot", 20000000, 1, [state, slot]() {
+        state->setValue(slot, sink);
+    }});
+    benchmarks.push_back({"evalstate/getValue/slot", 20000000, 1, [state, slot]() {
+        sink = state->getValue(slot);
+    }});
+
+    const int programLines = 1000;
+    auto lines = std::make_shared<std::vector<std::string>>();
+    for (int i = 0; i < programLines; i++) {
+        lines->push_back("LET A" + std::to_string(i % 50) + " = A" + std::to_string((i + 1) % 50) + " + " +
+                         std::to_string(i) + " * ( B - 7 ) / 3 ");
+    }
+    benchmarks.push_back({"program/addSourceLine", 50, programLines, [lines]() {
+        Program program;
+        for (int i = 0; i < programLines; i++) {
+            program.addSourceLine((i + 1) * 10, (*lines)[i]);
+        }
+    }});
+
+    benchmarks.push_back(runBench("run/tree", TREE_WALKER, 1000000));
+    benchmarks.push_back(runBench("run/threaded", THREADED, 1000000));
+    benchmarks.push_back(runBench("run/jit", JIT, 1000000));
+    return benchmarks;
+}
+
+/*
+ * Function: printResult
+ * Usage: printResult(result, format, first);
+ * ------------------------------------------
+ * Prints one result in the selected format.  The csv and json formats
+ * are meant for scripts comparing two builds; json is printed as one
+ * array, so first tells whether a separator is needed.
+ */
+
+static void printResult(const Result &result, const std::string &format, bool first) {
+    if (format == "csv") {
+        printf("%s,%llu,%.3f,%.3f,%.1f\n", result.name.c_str(), (unsigned long long) result.operations,
+               result.nsPerOp, result.allocsPerOp, result.bytesPerOp);
+    } else if (format == "json") {
+        printf("%s  {\"name\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.3f, \"allocs_per_op\": %.3f, "
+               "\"bytes_per_op\": %.1f}", first ? "" : ",\n", result.name.c_str(),
+               (unsigned long long) result.operations, result.nsPerOp, result.allocsPerOp, result.bytesPerOp);
+    } else {
+        printf("%-28s %12llu %12.2f %12.3f %12.1f\n", result.name.c_str(), (unsigned long long) result.operations,
+               result.nsPerOp, result.allocsPerOp, result.bytesPerOp);
+    }
+    fflush(stdout);
+}
+
+/* Main program */
+
+int main(int argc, char **argv) {
+    std::string format = "text";
+    std::string filter;
+    double scale = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 9, "--format=") == 0 &&
+            (arg.substr(9) == "text" || arg.substr(9) == "csv" || arg.substr(9) == "json")) {
+            format = arg.substr(9);
+        } else if (arg.compare(0, 9, "--filter=") == 0) {
+            filter = arg.substr(9);
+        } else if (arg.compare(0, 8, "--scale=") == 0) {
+            scale = atof(arg.c_str() + 8);
+        } else {
+            fprintf(stderr, "usage: %s [--format=text|csv|json] [--filter=text] [--scale=n]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (format == "csv") {
+        printf("name,ops,ns_per_op,allocs_per_op,bytes_per_op\n");
+    } else if (format == "json") {
+        printf("[\n");
+    } else {
+        printf("%-28s %12s %12s %12s %12s\n", "BENCHMARK", "OPS", "NS/OP", "ALLOCS/OP", "BYTES/OP");
+    }
+    bool first = true;
+    for (const Benchmark &bench : createBenchmarks()) {
+        if (std::string(bench.name).find(filter) == std::string::npos) continue;
+        printResult(measure(bench, scale), format, first);
+        first = false;
+    }
+    if (format == "json") printf("\n]\n");
+    return 0;
+}
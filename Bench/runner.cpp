@@ -0,0 +1,205 @@
+/*
+ * File: runner.cpp
+ * ----------------
+ * This file implements basic_runner, which runs the sessions written by
+ * basic_workload through one or more interpreters and reports, for
+ * each pair, the wall time, the peak resident set size and the number
+ * of BASIC statements executed per second.
+ *
+ * Usage: basic_runner directory binary... [--repeat=n] [--format=text|csv]
+ *
+ * Each session is fed to the interpreter on standard input, exactly as
+ * score.cpp feeds a trace.  With --repeat the session is run n times;
+ * the fastest time and the largest peak are reported.  The output of
+ * every run is hashed.  The row is marked DIFF when a run prints
+ * something different from the first run of the first interpreter
+ * named for the same session, or exits with another status than the
+ * first run of its own, so a comparison with Basic-Demo-64bit doubles
+ * as a correctness check.  The status shown is that of the first run
+ * that failed, if any did.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * Type: Workload
+ * --------------
+ * One row of workloads.csv.
+ */
+
+struct Workload {
+    std::string name;
+    std::string file;
+    uint64_t statements;
+};
+
+/*
+ * Type: Measurement
+ * -----------------
+ * What one run of a session produced.  Status is the exit status, or
+ * 128 plus the signal number if the interpreter was killed.
+ */
+
+struct Measurement {
+    double seconds;
+    long peakKilobytes;
+    uint64_t outputHash;
+    int status;
+};
+
+/*
+ * Function: readManifest
+ * Usage: std::vector<Workload> workloads = readManifest(dir);
+ * ------------------------------------------------------------
+ * Reads workloads.csv from the directory, skipping its header.  Exits
+ * if the file cannot be read.
+ */
+
+static std::vector<Workload> readManifest(const std::string &dir) {
+    FILE *file = fopen((dir + "/workloads.csv").c_str(), "r");
+    if (file == nullptr) {
+        perror((dir + "/workloads.csv").c_str());
+        exit(1);
+    }
+    std::vector<Workload> workloads;
+    char name[256], session[256];
+    unsigned long long statements;
+    fscanf(file, "%*[^\n]\n");
+    while (fscanf(file, "%255[^,],%255[^,],%llu\n", name, session, &statements) == 3) {
+        workloads.push_back({name, dir + "/" + session, statements});
+    }
+    fclose(file);
+    return workloads;
+}
+
+/*
+ * Function: runOnce
+ * Usage: Measurement m = runOnce(binary, session);
+ * ------------------------------------------------
+ * Runs the interpreter with the session file as standard input and
+ * standard output read back through a pipe.  The peak resident set
+ * size comes from the rusage of the child alone.
+ */
+
+static Measurement runOnce(const std::string &binary, const std::string &session) {
+    Measurement result = {0, 0, 0xcbf29ce484222325ull, -1};
+    int input = open(session.c_str(), O_RDONLY);
+    if (input < 0) {
+        perror(session.c_str());
+        exit(1);
+    }
+    int channel[2];
+    if (pipe(channel) < 0) {
+        perror("pipe");
+        exit(1);
+    }
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(input, STDIN_FILENO);
+        dup2(channel[1], STDOUT_FILENO);
+        close(input);
+        close(channel[0]);
+        close(channel[1]);
+        execl(binary.c_str(), binary.c_str(), (char *) nullptr);
+        perror(binary.c_str());
+        _exit(127);
+    }
+    close(input);
+    close(channel[1]);
+    char buffer[65536];
+    ssize_t n;
+    while ((n = read(channel[0], buffer, sizeof(buffer))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            result.outputHash = (result.outputHash ^ (unsigned char) buffer[i]) * 0x100000001b3ull;
+        }
+    }
+    close(channel[0]);
+    int status;
+    rusage usage;
+    if (pid < 0 || wait4(pid, &status, 0, &usage) < 0) {
+        perror("wait4");
+        exit(1);
+    }
+    auto finish = std::chrono::steady_clock::now();
+    result.seconds = std::chrono::duration<double>(finish - start).count();
+    result.peakKilobytes = usage.ru_maxrss;
+    result.status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    return result;
+}
+
+/* Main program */
+
+int main(int argc, char **argv) {
+    std::string dir;
+    std::vector<std::string> binaries;
+    std::string format = "text";
+    int repeat = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 9, "--repeat=") == 0 && atoi(arg.c_str() + 9) > 0) {
+            repeat = atoi(arg.c_str() + 9);
+        } else if (arg == "--format=text" || arg == "--format=csv") {
+            format = arg.substr(9);
+        } else if (arg[0] == '-') {
+            binaries.clear();
+            break;
+        } else if (dir.empty()) {
+            dir = arg;
+        } else {
+            binaries.push_back(arg);
+        }
+    }
+    if (binaries.empty()) {
+        fprintf(stderr, "usage: %s directory binary... [--repeat=n] [--format=text|csv]\n", argv[0]);
+        return 1;
+    }
+    if (format == "csv") {
+        printf("workload,binary,wall_s,peak_rss_kb,statements,statements_per_s,output_hash,status,same_output\n");
+    } else {
+        printf("%-10s %-24s %10s %10s %14s %16s %s\n", "WORKLOAD", "BINARY", "WALL(s)", "RSS(MB)", "STMT/S",
+               "OUTPUT", "STATUS");
+    }
+    for (const Workload &workload : readManifest(dir)) {
+        uint64_t reference = 0;
+        for (size_t b = 0; b < binaries.size(); b++) {
+            Measurement best = runOnce(binaries[b], workload.file);
+            if (b == 0) reference = best.outputHash;
+            bool same = best.outputHash == reference;
+            for (int r = 1; r < repeat; r++) {
+                Measurement next = runOnce(binaries[b], workload.file);
+                best.seconds = std::min(best.seconds, next.seconds);
+                best.peakKilobytes = std::max(best.peakKilobytes, next.peakKilobytes);
+                same = same && next.outputHash == reference && next.status == best.status;
+                if (best.status == 0) best.status = next.status;
+            }
+            double rate = best.status == 0 ? workload.statements / best.seconds : 0;
+            if (format == "csv") {
+                printf("%s,%s,%.4f,%ld,%llu,%.0f,%016llx,%d,%s\n", workload.name.c_str(), binaries[b].c_str(),
+                       best.seconds, best.peakKilobytes, (unsigned long long) workload.statements, rate,
+                       (unsigned long long) best.outputHash, best.status, same ? "yes" : "no");
+            } else {
+                printf("%-10s %-24s %10.3f %10.1f %14.0f %016llx %d%s\n", workload.name.c_str(),
+                       binaries[b].c_str(), best.seconds, best.peakKilobytes / 1024.0, rate,
+                       (unsigned long long) best.outputHash, best.status, same ? "" : " DIFF");
+            }
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,312 @@
+/*
+ * File: workload.cpp
+ * ------------------
+ * This file implements basic_workload, which writes a set of synthetic
+ * BASIC sessions for measuring the interpreter end to end:
+ *
+ *    count     a tight counting loop
+ *    sieve     counting primes by trial division with IF/GOTO chains
+ *    arith     a block of arithmetic-heavy LET statements run in a loop
+ *    straight  a straight-line program of one million lines
+ *    input     a loop that reads and sums a long list of INPUT values
+ *
+ * Each session is a file in the format of the traces in Test/: the
+ * program lines, RUN, any values read by INPUT, and QUIT.  Every
+ * interpreter under test can therefore read it from standard input.
+ * The generator also writes workloads.csv, which names each session
+ * and gives the number of statements it executes, so that
+ * basic_runner can report throughput.  The counts come from running
+ * the same loops in C++ here.
+ *
+ * Usage: basic_workload directory [--scale=x] [--only=name]
+ *
+ * --scale multiplies the size of every workload; --only writes just
+ * the named workload.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+/*
+ * Type: Workload
+ * --------------
+ * One generated session: its name and the number of statements it
+ * executes between RUN and QUIT.
+ */
+
+struct Workload {
+    std::string name;
+    uint64_t statements;
+};
+
+/*
+ * Class: SessionWriter
+ * --------------------
+ * Writes the lines of one session and numbers program lines in steps
+ * of ten.
+ */
+
+class SessionWriter {
+
+public:
+
+    explicit SessionWriter(const std::string &filename) : file(fopen(filename.c_str(), "w")), next(10) {
+        if (file == nullptr) {
+            perror(filename.c_str());
+            exit(1);
+        }
+    }
+
+    ~SessionWriter() {
+        fclose(file);
+    }
+
+/*
+ * Method: line
+ * Usage: int number = session.line("LET A = 1");
+ * ----------------------------------------------
+ * Adds a program line and returns its line number.
+ */
+
+    int line(const std::string &text) {
+        fprintf(file, "%d %s\n", next, text.c_str());
+        next += 10;
+        return next - 10;
+    }
+
+/*
+ * Method: peek
+ * Usage: int number = session.peek();
+ * -----------------------------------
+ * Returns the number the next program line will get, for forward
+ * jumps.
+ */
+
+    int peek() const {
+        return next;
+    }
+
+/*
+ * Method: raw
+ * Usage: session.raw("RUN");
+ * --------------------------
+ * Writes a line as it stands.
+ */
+
+    void raw(const std::string &text) {
+        fprintf(file, "%s\n", text.c_str());
+    }
+
+private:
+
+    FILE *file;
+    int next;
+
+};
+
+static std::string str(long long value) {
+    return std::to_string(value);
+}
+
+/*
+ * Function: writeCount
+ * --------------------
+ * I counts from 0 to n; two statements per iteration.
+ */
+
+static Workload writeCount(const std::string &dir, long long n) {
+    SessionWriter session(dir + "/count.txt");
+    session.line("LET I = 0");
+    int loop = session.line("LET I = I + 1");
+    session.line("IF I < " + str(n) + " THEN " + str(loop));
+    session.line("PRINT I");
+    session.line("END");
+    session.raw("RUN");
+    session.raw("QUIT");
+    return {"count", uint64_t(1 + 2 * n + 2)};
+}
+
+/*
+ * Function: writeSieve
+ * --------------------
+ * Counts the primes up to limit by trial division.  The language has
+ * no arrays, so the sieve is the usual chain of IF/GOTO tests; the
+ * remainder is computed as N - N / D * D.  The statement count is
+ * obtained by running the same loop.
+ */
+
+static Workload writeSieve(const std::string &dir, long long limit) {
+    SessionWriter session(dir + "/sieve.txt");
+    session.line("LET C = 0");
+    session.line("LET N = 2");
+    int outer = session.line("LET D = 2");
+    int test = session.peek();
+    int prime = test + 40;
+    int composite = test + 50;
+    session.line("IF D * D > N THEN " + str(prime));
+    session.line("IF N - N / D * D = 0 THEN " + str(composite));
+    session.line("LET D = D + 1");
+    session.line("GOTO " + str(test));
+    session.line("LET C = C + 1");
+    session.line("LET N = N + 1");
+    session.line("IF N < " + str(limit + 1) + " THEN " + str(outer));
+    session.line("PRINT C");
+    session.line("END");
+    session.raw("RUN");
+    session.raw("QUIT");
+    uint64_t statements = 2;
+    for (long long n = 2; n <= limit; n++) {
+        statements++;
+        long long d = 2;
+        while (true) {
+            statements++;
+            if (d * d > n) {
+                statements++;
+                break;
+            }
+            statements++;
+            if (n % d == 0) break;
+            statements += 2;
+            d++;
+        }
+        statements += 2;
+    }
+    return {"sieve", statements + 2};
+}
+
+/*
+ * Function: writeArith
+ * --------------------
+ * Runs a block of LET statements with several operators each, over 26
+ * variables.  Every value is a weighted mean of two others, so the
+ * values stay small and no run depends on how overflow is handled.
+ */
+
+static Workload writeArith(const std::string &dir, long long lines, long long reps) {
+    SessionWriter session(dir + "/arith.txt");
+    for (int v = 0; v < 26; v++) {
+        session.line("LET " + std::string(1, char('A' + v)) + " = " + str(v * 37 + 11));
+    }
+    session.line("LET REP = 0");
+    int block = session.peek();
+    for (long long i = 0; i < lines; i++) {
+        std::string target(1, char('A' + i % 26));
+        std::string first(1, char('A' + (i + 1) % 26));
+        std::string second(1, char('A' + (i + 2) % 26));
+        session.line("LET " + target + " = (" + first + " * 3 + " + str(i % 100) + ") / 4 - " + second + " / 8");
+    }
+    session.line("LET REP = REP + 1");
+    session.line("IF REP < " + str(reps) + " THEN " + str(block));
+    session.line("PRINT A");
+    session.line("END");
+    session.raw("RUN");
+    session.raw("QUIT");
+    return {"arith", uint64_t(26 + 1 + reps * (lines + 2) + 2)};
+}
+
+/*
+ * Function: writeStraight
+ * -----------------------
+ * A program of the given number of lines, at least four, without a
+ * single jump, so that loading the program dominates the session.
+ */
+
+static Workload writeStraight(const std::string &dir, long long lines) {
+    if (lines < 4) lines = 4;
+    SessionWriter session(dir + "/straight.txt");
+    session.line("LET A = 0");
+    session.line("LET B = 0");
+    for (long long i = 0; i < lines - 4; i++) {
+        if (i % 2 == 1) {
+            session.line("LET B = A / 7 - B");
+        } else {
+            session.line("LET A = A " + std::string(i % 4 == 0 ? "+ " : "- ") + str(i % 1000));
+        }
+    }
+    session.line("PRINT A + B");
+    session.line("END");
+    session.raw("RUN");
+    session.raw("QUIT");
+    return {"straight", uint64_t(lines)};
+}
+
+/*
+ * Function: writeInput
+ * --------------------
+ * Reads and sums n values supplied after RUN.
+ */
+
+static Workload writeInput(const std::string &dir, long long n) {
+    SessionWriter session(dir + "/input.txt");
+    session.line("LET S = 0");
+    session.line("LET I = 0");
+    int loop = session.line("INPUT X");
+    session.line("LET S = S + X");
+    session.line("LET I = I + 1");
+    session.line("IF I < " + str(n) + " THEN " + str(loop));
+    session.line("PRINT S");
+    session.line("END");
+    session.raw("RUN");
+    for (long long i = 0; i < n; i++) {
+        session.raw(str(i * 7919 % 1000 - 500));
+    }
+    session.raw("QUIT");
+    return {"input", uint64_t(2 + 4 * n + 2)};
+}
+
+static long long scaled(long long size, double scale) {
+    long long value = (long long) (size * scale);
+    return value < 1 ? 1 : value;
+}
+
+/* Main program */
+
+int main(int argc, char **argv) {
+    std::string dir;
+    std::string only;
+    double scale = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 8, "--scale=") == 0) {
+            scale = atof(arg.c_str() + 8);
+        } else if (arg.compare(0, 7, "--only=") == 0) {
+            only = arg.substr(7);
+        } else if (arg[0] != '-' && dir.empty()) {
+            dir = arg;
+        } else {
+            dir.clear();
+            break;
+        }
+    }
+    if (dir.empty() || scale <= 0) {
+        fprintf(stderr, "usage: %s directory [--scale=x] [--only=count|sieve|arith|straight|input]\n", argv[0]);
+        return 1;
+    }
+    mkdir(dir.c_str(), 0777);
+    std::vector<Workload> workloads;
+    if (only.empty() || only == "count") workloads.push_back(writeCount(dir, scaled(1000000, scale)));
+    if (only.empty() || only == "sieve") workloads.push_back(writeSieve(dir, scaled(20000, scale)));
+    if (only.empty() || only == "arith") workloads.push_back(writeArith(dir, 200, scaled(2000, scale)));
+    if (only.empty() || only == "straight") workloads.push_back(writeStraight(dir, scaled(1000000, scale)));
+    if (only.empty() || only == "input") workloads.push_back(writeInput(dir, scaled(100000, scale)));
+    if (workloads.empty()) {
+        fprintf(stderr, "%s: unknown workload %s\n", argv[0], only.c_str());
+        return 1;
+    }
+    FILE *manifest = fopen((dir + "/workloads.csv").c_str(), "w");
+    if (manifest == nullptr) {
+        perror("workloads.csv");
+        return 1;
+    }
+    fprintf(manifest, "name,file,statements\n");
+    for (const Workload &workload : workloads) {
+        fprintf(manifest, "%s,%s.txt,%llu\n", workload.name.c_str(), workload.name.c_str(),
+                (unsigned long long) workload.statements);
+    }
+    fclose(manifest);
+    return 0;
+}
@@ -0,0 +1,85 @@
+#!/bin/sh
+#
+# File: run_cache.sh
+# ------------------
+# Runs a BASIC file in script mode the way the compile cache sees it in
+# use: a first run that writes file.bas.cache, a run from that cache,
+# runs after the cache has been overwritten with garbage or cut short,
+# and runs after the source has changed behind a valid cache.  Every
+# run must print what the same source prints with --no-cache.
+#
+# Usage: run_cache.sh code engine-option script.bas expected.ans
+
+code=$1
+engine=$2
+script=$3
+expected=$4
+
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+absolute() {
+    case $1 in
+        /*) echo "$1" ;;
+        *) echo "$PWD/$1" ;;
+    esac
+}
+code=$(absolute "$code")
+script=$(absolute "$script")
+expected=$(absolute "$expected")
+cp "$script" "$work/test.bas" || exit 1
+cd "$work" || exit 1
+status=0
+
+check() {
+    "$code" "$engine" test.bas > output.txt 2> /dev/null
+    if ! cmp -s "$1" output.txt; then
+        echo "$(basename "$script") with $engine, $2: output differs"
+        diff "$1" output.txt | head -20
+        status=1
+    fi
+}
+
+check "$expected" "first run"
+if [ ! -s test.bas.cache ]; then
+    echo "$(basename "$script") with $engine: no cache was written"
+    exit 1
+fi
+cp test.bas.cache good.cache
+check "$expected" "run from the cache"
+
+head -c 1000 /dev/urandom > test.bas.cache
+check "$expected" "garbage cache"
+head -c 100 good.cache > test.bas.cache
+check "$expected" "truncated cache"
+
+# Several interpreters writing the same cache at once
+rm -f test.bas.cache
+for i in 1 2 3 4; do
+    "$code" "$engine" test.bas > "output$i.txt" 2> /dev/null &
+done
+wait
+for i in 1 2 3 4; do
+    cmp -s "$expected" "output$i.txt" || { echo "concurrent run $i: output differs"; status=1; }
+done
+check "$expected" "cache written concurrently"
+if ls test.bas.cache.* > /dev/null 2>&1; then
+    echo "$(basename "$script") with $engine: temporary cache files left behind"
+    status=1
+fi
+
+# The source changes, the cache stays: first the same length, then longer
+cp good.cache test.bas.cache
+sed 's/^20 LET N = 5$/20 LET N = 4/' "$script" > test.bas
+"$code" "$engine" --no-cache test.bas > fresh.txt 2> /dev/null
+if cmp -s "$expected" fresh.txt; then
+    echo "$(basename "$script"): changing line 20 does not change the output"
+    status=1
+fi
+check fresh.txt "stale cache, same length"
+
+cp good.cache test.bas.cache
+cp "$script" test.bas
+echo "135 PRINT N" >> test.bas
+"$code" "$engine" --no-cache test.bas > fresh.txt 2> /dev/null
+check fresh.txt "stale cache, longer source"
+exit $status
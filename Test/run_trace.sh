@@ -0,0 +1,27 @@
+#!/bin/sh
+#
+# File: run_trace.sh
+# ------------------
+# Runs one trace through the interpreter and compares what it prints
+# with the expected output.  The interpreter runs in a scratch directory,
+# so files written by SAVE or PROFILE CSV do not end up in the tree.
+#
+# Usage: run_trace.sh code engine-option trace.txt expected.ans
+
+code=$1
+engine=$2
+trace=$3
+expected=$4
+
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+case $code in
+    /*) ;;
+    *) code=$PWD/$code ;;
+esac
+(cd "$work" && exec "$code" "$engine") < "$trace" > "$work/output.txt" 2> /dev/null
+if ! cmp -s "$expected" "$work/output.txt"; then
+    echo "$(basename "$trace") with $engine: output differs from $(basename "$expected")"
+    diff "$expected" "$work/output.txt" | head -40
+    exit 1
+fi
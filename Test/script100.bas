@@ -0,0 +1,14 @@
+10 REM sums of squares and a countdown, for the cache tests
+20 LET N = 5
+30 LET I = 1
+40 LET S = 0
+50 LET S = S + I * I
+60 PRINT S
+70 LET I = I + 1
+80 IF I < N + 1 THEN 50
+90 IF S > 50 THEN 120
+100 PRINT 0 - 1
+110 GOTO 140
+120 LET S = S / (N - 4) - 100
+130 PRINT S
+140 END
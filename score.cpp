@@ -106,9 +106,15 @@ void clearTempFiles() {
     (void) r;
 }
 
+// A trace with a .ans file next to it is checked against that file instead of the demo program,
+// so it also covers commands the demo does not know (SAVE, LOAD, PROFILE).
+
 int testTrace(const char *trace) {
     clearTempFiles();
-    if (system((string() + "cat " + trace + " | timeout 1 " + standerBasic + " > test_ans 2> /dev/null").c_str()) !=
+    string answer = string(trace).substr(0, string(trace).rfind('.')) + ".ans";
+    if (access(answer.c_str(), R_OK) == 0) {
+        if (system((string() + "cp " + answer + " test_ans").c_str()) != 0) return 1;
+    } else if (system((string() + "cat " + trace + " | timeout 1 " + standerBasic + " > test_ans 2> /dev/null").c_str()) !=
         0)
         return 1;
     if (system((string() + "cat " + trace + " | timeout 1 " + studentBasic + " > test_out 2> /dev/null").c_str()) !=
@@ -182,7 +188,7 @@ int main(int argc, char **argv) {
         /**************************************************************
          if you modify the structure of the files, you should modify the file paths here.
          **************************************************************/
-        system("g++ -std=c++17 -o testcode Basic/Basic.cpp Basic/evalstate.cpp Basic/exp.cpp Basic/parser.cpp Basic/program.cpp Basic/statement.cpp Basic/Utils/error.cpp Basic/Utils/tokenScanner.cpp Basic/Utils/strlib.cpp");
+        system("g++ -std=c++17 -pthread -o testcode Basic/Basic.cpp Basic/arena.cpp Basic/cache.cpp Basic/evalstate.cpp Basic/exp.cpp Basic/input.cpp Basic/jit.cpp Basic/output.cpp Basic/parser.cpp Basic/profiler.cpp Basic/program.cpp Basic/statement.cpp Basic/threaded.cpp Basic/Utils/error.cpp Basic/Utils/lexer.cpp Basic/Utils/tokenScanner.cpp Basic/Utils/strlib.cpp");
         system("chmod a+rwx Basic-Demo-64bit");
         if (traceFile.size()) runTest(traceFile);
         else {